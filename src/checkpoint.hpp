@@ -0,0 +1,176 @@
+#pragma once
+#include "settings.hpp"
+
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A checkpoint is a checkpoint_header, zero padded to checkpoint_header_size, followed by the packed particle buffer byte
+// for byte: both position/velocity halves, force, density and pressure at the offsets compute_buffer_layout gives them.
+// The payload starts on a page boundary, so a restore maps the file and copies the payload into the staging buffer in
+// one memcpy. Files are native-endian. The arrays hold particle_count slots, of which the first live_count are particles.
+constexpr uint32_t checkpoint_version = 2;
+constexpr size_t checkpoint_header_size = 4096;
+
+enum checkpoint_flags : uint32_t {
+    checkpoint_compact_layout = 1 // fp16 velocity, density and pressure
+};
+
+struct checkpoint_header {
+    char magic[8]; // "SPHCKPT\0"
+    uint32_t version;
+    uint32_t header_size; // where the payload starts
+    uint64_t payload_size; // the packed particle buffer
+    uint32_t particle_count; // slots of every array
+    uint32_t flags;
+    uint64_t parameter_hash; // of the constants the state was simulated with, see checkpoint_parameter_hash
+    uint64_t simulation_step;
+    uint32_t current_state; // the half of the position/velocity pair the last step wrote
+    float dt; // the time step state, for runs with an adaptive dt
+    uint32_t time_step_count;
+    float simulated_time;
+    uint32_t live_count; // particles at the front of the arrays
+    uint32_t reserved;
+};
+
+static_assert(sizeof(checkpoint_header) == 72, "the checkpoint header is written as is");
+static_assert(sizeof(checkpoint_header) <= checkpoint_header_size);
+
+// FNV-1a over the push constants and the particle radius; a state only continues the same simulation under the same ones
+inline uint64_t checkpoint_parameter_hash(const sim_params& params) {
+    const auto constants = params.push_constants();
+
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&](const void* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<const uint8_t*>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    add(&constants, sizeof(constants));
+    add(&params.radius, sizeof(params.radius));
+
+    return hash;
+}
+
+// a read-only mapping of a whole file; pages are read from disk as they are first touched
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("cannot open " + path);
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<size_t>(size.QuadPart);
+
+        if (size_ > 0) {
+            mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data_ = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        }
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            throw std::runtime_error("cannot open " + path);
+
+        struct stat status{};
+        fstat(descriptor, &status);
+        size_ = static_cast<size_t>(status.st_size);
+
+        if (size_ > 0) {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (data_ == MAP_FAILED)
+                data_ = nullptr;
+            else
+                madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+
+        close(descriptor);
+#endif
+        if (size_ > 0 && !data_) {
+            release();
+            throw std::runtime_error("cannot map " + path);
+        }
+    }
+
+    ~mapped_file() {
+        release();
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const char* data() const {
+        return static_cast<const char*>(data_);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    void release() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_) munmap(data_, size_);
+#endif
+        data_ = nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// the header of a mapped checkpoint, checked against everything that does not depend on the device
+inline checkpoint_header read_checkpoint_header(const mapped_file& file, const std::string& path) {
+    checkpoint_header header{};
+
+    if (file.size() < sizeof(header))
+        throw std::runtime_error(path + " is not a checkpoint");
+
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, "SPHCKPT", 8) != 0)
+        throw std::runtime_error(path + " is not a checkpoint");
+
+    if (header.version != checkpoint_version)
+        throw std::runtime_error(path + " is a version " + std::to_string(header.version) + " checkpoint, expected version " + std::to_string(checkpoint_version));
+
+    if (header.header_size < sizeof(header) || file.size() < header.header_size + header.payload_size)
+        throw std::runtime_error(path + " is truncated");
+
+    return header;
+}
+
+// the particle count, capacity and layout are fixed by the checkpoint, not by the command line
+inline void adopt_checkpoint_layout(simulation_settings& settings) {
+    mapped_file file(settings.restore_path);
+    auto header = read_checkpoint_header(file, settings.restore_path);
+
+    settings.particle_capacity = header.particle_count;
+    settings.particle_count = header.live_count;
+    settings.compact_storage = header.flags & checkpoint_compact_layout;
+}
@@ -0,0 +1,12 @@
+// storage types of the particle arrays; every shader that includes this is built twice by embed_shaders.py: plain, and
+// with -DCOMPACT_STORAGE into <name>.compact.comp.spv for the fp16 particle layout
+#ifdef COMPACT_STORAGE
+#extension GL_EXT_shader_16bit_storage : require
+#define vec2_storage f16vec2
+#define float_storage float16_t
+#define pressure_scale stiffness // fp16 tops out at 65504, so pressure is stored in units of the stiffness
+#else
+#define vec2_storage vec2
+#define float_storage float
+#define pressure_scale 1.f
+#endif
@@ -1,13 +1,13 @@
-#pragma once
-#include <vulkan/vulkan.hpp>
-#include <GLFW/glfw3.h>
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/gtc/matrix_transform.hpp>
-
-#include <memory>
-#include <functional>
-#include <iostream>
-#include <chrono> //does precies timekeeping
-
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <GLFW/glfw3.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <memory>
+#include <functional>
+#include <iostream>
+#include <chrono> //does precies timekeeping
+
 #include <unordered_map>
\ No newline at end of file
@@ -0,0 +1,494 @@
+#pragma once
+#include "fluid.hpp"
+#include "task_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// the few float operations the neighbour loops need, one lane per particle j
+namespace cpu_simd {
+    struct scalar_batch {
+        static constexpr size_t width = 1;
+        static constexpr const char* name = "scalar";
+
+        float v;
+
+        static scalar_batch load(const float* p) { return { *p }; }
+        static scalar_batch broadcast(float x) { return { x }; }
+
+        friend scalar_batch operator+(scalar_batch a, scalar_batch b) { return { a.v + b.v }; }
+        friend scalar_batch operator-(scalar_batch a, scalar_batch b) { return { a.v - b.v }; }
+        friend scalar_batch operator*(scalar_batch a, scalar_batch b) { return { a.v * b.v }; }
+        friend scalar_batch operator/(scalar_batch a, scalar_batch b) { return { a.v / b.v }; }
+        friend scalar_batch sqrt(scalar_batch a) { return { std::sqrt(a.v) }; }
+
+        // `value` in the lanes where a < b, zero in the others
+        friend scalar_batch select_less(scalar_batch a, scalar_batch b, scalar_batch value) { return { a.v < b.v ? value.v : 0.f }; }
+
+        float sum() const { return v; }
+    };
+
+#if defined(__AVX2__)
+    struct avx2_batch {
+        static constexpr size_t width = 8;
+        static constexpr const char* name = "avx2";
+
+        __m256 v;
+
+        static avx2_batch load(const float* p) { return { _mm256_loadu_ps(p) }; }
+        static avx2_batch broadcast(float x) { return { _mm256_set1_ps(x) }; }
+
+        friend avx2_batch operator+(avx2_batch a, avx2_batch b) { return { _mm256_add_ps(a.v, b.v) }; }
+        friend avx2_batch operator-(avx2_batch a, avx2_batch b) { return { _mm256_sub_ps(a.v, b.v) }; }
+        friend avx2_batch operator*(avx2_batch a, avx2_batch b) { return { _mm256_mul_ps(a.v, b.v) }; }
+        friend avx2_batch operator/(avx2_batch a, avx2_batch b) { return { _mm256_div_ps(a.v, b.v) }; }
+        friend avx2_batch sqrt(avx2_batch a) { return { _mm256_sqrt_ps(a.v) }; }
+
+        friend avx2_batch select_less(avx2_batch a, avx2_batch b, avx2_batch value) {
+            return { _mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ), value.v) };
+        }
+
+        float sum() const {
+            __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+            s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+            return _mm_cvtss_f32(s);
+        }
+    };
+
+    using native_batch = avx2_batch;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    struct neon_batch {
+        static constexpr size_t width = 4;
+        static constexpr const char* name = "neon";
+
+        float32x4_t v;
+
+        static neon_batch load(const float* p) { return { vld1q_f32(p) }; }
+        static neon_batch broadcast(float x) { return { vdupq_n_f32(x) }; }
+
+        friend neon_batch operator+(neon_batch a, neon_batch b) { return { vaddq_f32(a.v, b.v) }; }
+        friend neon_batch operator-(neon_batch a, neon_batch b) { return { vsubq_f32(a.v, b.v) }; }
+        friend neon_batch operator*(neon_batch a, neon_batch b) { return { vmulq_f32(a.v, b.v) }; }
+        friend neon_batch operator/(neon_batch a, neon_batch b) { return { vdivq_f32(a.v, b.v) }; }
+        friend neon_batch sqrt(neon_batch a) { return { vsqrtq_f32(a.v) }; }
+
+        friend neon_batch select_less(neon_batch a, neon_batch b, neon_batch value) {
+            return { vreinterpretq_f32_u32(vandq_u32(vcltq_f32(a.v, b.v), vreinterpretq_u32_f32(value.v))) };
+        }
+
+        float sum() const { return vaddvq_f32(v); }
+    };
+
+    using native_batch = neon_batch;
+#else
+    using native_batch = scalar_batch;
+#endif
+}
+
+// The density/pressure, force and position passes of the fp32 GPU layout on the CPU, with the same push constants, so a
+// step can run and be checked without a device. The state is kept SoA in generation order like the packed buffer. Each
+// step bins the particles into the uniform grid of the GPU (cells of size h over the bounding box) with a counting sort
+// and gathers positions and velocities into cell order, which makes the 3x3 neighbour cells three contiguous rows of j.
+// The neighbour loops run over those rows in SIMD batches of j.
+//
+// The passes run as a task graph on a work-stealing scheduler. The cells are cut, in index order, into blocks that each
+// hold about the same number of particles, so the dense floor of the box is split finely and the empty space above it
+// ends up in a few large blocks. Per block there is a density, a force and a position task. A force task waits only for
+// the density tasks of the blocks its neighbour cells fall into, and a position task only for its own force task, so a
+// block can integrate while the density of the other end of the box is still being summed. Only the fixed time step
+// is mirrored; the sums run in a different order than on the GPU, so results agree to rounding, not bit for bit.
+class cpu_solver {
+public:
+    cpu_solver(const std::vector<glm::vec2>& positions, const simulation_settings& settings, uint32_t thread_count = 0, bool vectorized = true)
+        : constants_(settings.params.push_constants()), h_(settings.params.kernel_radius()), grid_resolution_(settings.params.grid_resolution()),
+          vectorized_(vectorized), scheduler_(thread_count) {
+        const size_t count = positions.size();
+
+        x_.resize(count);
+        y_.resize(count);
+        vx_.assign(count, 0.f);
+        vy_.assign(count, 0.f);
+        fx_.assign(count, 0.f);
+        fy_.assign(count, 0.f);
+        density_.assign(count, 0.f);
+        pressure_.assign(count, 0.f);
+
+        for (size_t i = 0; i < count; ++i) {
+            x_[i] = positions[i].x;
+            y_[i] = positions[i].y;
+        }
+
+        particle_cell_.resize(count);
+        sorted_index_.resize(count);
+        cell_start_.resize(static_cast<size_t>(grid_resolution_) * grid_resolution_ + 1);
+
+        sorted_x_.resize(count);
+        sorted_y_.resize(count);
+        sorted_vx_.resize(count);
+        sorted_vy_.resize(count);
+        sorted_density_.resize(count);
+        sorted_pressure_.resize(count);
+    }
+
+    void step() {
+        bin_particles();
+        build_step_graph();
+
+        const uint32_t blocks = static_cast<uint32_t>(block_first_cell_.size()) - 1;
+
+        scheduler_.run(step_graph_, [this, blocks](uint32_t task) {
+            const uint32_t block = task % blocks;
+            const uint32_t begin = cell_start_[block_first_cell_[block]];
+            const uint32_t end = cell_start_[block_first_cell_[block + 1]];
+
+            switch (task / blocks) {
+                case 0: density_pressure_pass(begin, end); break;
+                case 1: force_pass(begin, end); break;
+                default: position_pass(begin, end); break;
+            }
+        });
+    }
+
+    void run(uint64_t steps) {
+        for (uint64_t i = 0; i < steps; ++i)
+            step();
+    }
+
+    // same fields and units as device_context::download_particles
+    particle_snapshot snapshot() const {
+        const size_t count = x_.size();
+
+        particle_snapshot snapshot{};
+        snapshot.position.resize(count);
+        snapshot.velocity.resize(count);
+        snapshot.force.resize(count);
+        snapshot.density = density_;
+        snapshot.pressure = pressure_;
+
+        for (size_t i = 0; i < count; ++i) {
+            snapshot.position[i] = { x_[i], y_[i] };
+            snapshot.velocity[i] = { vx_[i], vy_[i] };
+            snapshot.force[i] = { fx_[i], fy_[i] };
+        }
+
+        return snapshot;
+    }
+
+    size_t particle_count() const {
+        return x_.size();
+    }
+
+    uint32_t thread_count() const {
+        return scheduler_.thread_count();
+    }
+
+    // blocks of cells the last step was cut into
+    size_t block_count() const {
+        return block_first_cell_.size() - 1;
+    }
+
+    const task_scheduler& scheduler() const {
+        return scheduler_;
+    }
+
+    void reset_scheduler_stats() {
+        scheduler_.reset_stats();
+    }
+
+    const char* instruction_set() const {
+        return vectorized_ ? cpu_simd::native_batch::name : cpu_simd::scalar_batch::name;
+    }
+
+private:
+    struct force_sums {
+        float pressure_x = 0.f;
+        float pressure_y = 0.f;
+        float viscosity_x = 0.f;
+        float viscosity_y = 0.f;
+    };
+
+    // grid_count.comp: positions outside the box are clamped into the border cells
+    uint32_t cell_of(float x, float y) const {
+        const int last = static_cast<int>(grid_resolution_) - 1;
+        int cx = std::clamp(static_cast<int>(std::floor((x + constants_.bounding_box.x) / h_)), 0, last);
+        int cy = std::clamp(static_cast<int>(std::floor((y + constants_.bounding_box.y) / h_)), 0, last);
+        return static_cast<uint32_t>(cy) * grid_resolution_ + static_cast<uint32_t>(cx);
+    }
+
+    // a counting sort by cell, stable in generation order, then the state the neighbour loops read is gathered into it
+    void bin_particles() {
+        scheduler_.parallel_for(x_.size(), [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                particle_cell_[i] = cell_of(x_[i], y_[i]);
+        });
+
+        std::fill(cell_start_.begin(), cell_start_.end(), 0u);
+
+        for (uint32_t cell : particle_cell_)
+            ++cell_start_[cell + 1];
+
+        for (size_t cell = 1; cell < cell_start_.size(); ++cell)
+            cell_start_[cell] += cell_start_[cell - 1];
+
+        // advances a copy of the starts so cell_start_ keeps them for the neighbour loops
+        cell_fill_.assign(cell_start_.begin(), cell_start_.end() - 1);
+
+        for (uint32_t i = 0; i < particle_cell_.size(); ++i)
+            sorted_index_[cell_fill_[particle_cell_[i]]++] = i;
+
+        scheduler_.parallel_for(x_.size(), [this](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; ++s) {
+                uint32_t i = sorted_index_[s];
+                sorted_x_[s] = x_[i];
+                sorted_y_[s] = y_[i];
+                sorted_vx_[s] = vx_[i];
+                sorted_vy_[s] = vy_[i];
+            }
+        });
+    }
+
+    // the sorted j ranges [begin, end) of the up to three rows of neighbour cells around `cell`
+    template <typename visitor>
+    void for_each_neighbor_row(uint32_t cell, visitor&& visit) const {
+        const int last = static_cast<int>(grid_resolution_) - 1;
+        const int cx = static_cast<int>(cell % grid_resolution_);
+        const int cy = static_cast<int>(cell / grid_resolution_);
+
+        const int x0 = std::max(cx - 1, 0);
+        const int x1 = std::min(cx + 1, last);
+
+        for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, last); ++y)
+            visit(cell_start_[y * grid_resolution_ + x0], cell_start_[y * grid_resolution_ + x1 + 1]);
+    }
+
+    // density_pressure.comp: sum of (h^2 - r^2)^3 over j with r < h, i itself included; m * poly6 is applied once by the caller
+    template <typename batch>
+    float density_sum(float xi, float yi, uint32_t begin, uint32_t end) const {
+        const auto x = batch::broadcast(xi);
+        const auto y = batch::broadcast(yi);
+        const auto h2 = batch::broadcast(h_ * h_);
+
+        auto sum = batch::broadcast(0.f);
+        uint32_t j = begin;
+
+        for (; j + batch::width <= end; j += batch::width) {
+            auto dx = x - batch::load(&sorted_x_[j]);
+            auto dy = y - batch::load(&sorted_y_[j]);
+            auto r2 = dx * dx + dy * dy;
+            auto d = h2 - r2;
+
+            sum = sum + select_less(r2, h2, d * d * d);
+        }
+
+        if constexpr (batch::width > 1)
+            return sum.sum() + density_sum<cpu_simd::scalar_batch>(xi, yi, j, end);
+        else
+            return sum.sum();
+    }
+
+    // force.comp: pressure and viscosity terms of the j in [begin, end), which must not contain i
+    template <typename batch>
+    void force_sum(uint32_t s, uint32_t begin, uint32_t end, force_sums& sums) const {
+        const auto x = batch::broadcast(sorted_x_[s]);
+        const auto y = batch::broadcast(sorted_y_[s]);
+        const auto vx = batch::broadcast(sorted_vx_[s]);
+        const auto vy = batch::broadcast(sorted_vy_[s]);
+        const auto pressure = batch::broadcast(sorted_pressure_[s]);
+        const auto h = batch::broadcast(h_);
+        const auto h2 = batch::broadcast(h_ * h_);
+        const auto pressure_factor = batch::broadcast(constants_.m * constants_.spiky_gradient / 2.f);
+        const auto viscosity_factor = batch::broadcast(constants_.m * constants_.viscosity_laplacian);
+
+        auto pressure_x = batch::broadcast(0.f);
+        auto pressure_y = batch::broadcast(0.f);
+        auto viscosity_x = batch::broadcast(0.f);
+        auto viscosity_y = batch::broadcast(0.f);
+        uint32_t j = begin;
+
+        for (; j + batch::width <= end; j += batch::width) {
+            auto dx = x - batch::load(&sorted_x_[j]);
+            auto dy = y - batch::load(&sorted_y_[j]);
+            auto r2 = dx * dx + dy * dy;
+            auto r = sqrt(r2);
+            auto h_r = h - r;
+            auto density_j = batch::load(&sorted_density_[j]);
+
+            // m (p_i + p_j) / (2 rho_j) * spiky (h - r)^2, times delta / r for normalize(delta)
+            auto pressure_term = select_less(r2, h2, pressure_factor * (pressure + batch::load(&sorted_pressure_[j])) / density_j * h_r * h_r / r);
+            pressure_x = pressure_x - pressure_term * dx;
+            pressure_y = pressure_y - pressure_term * dy;
+
+            auto viscosity_term = select_less(r2, h2, viscosity_factor / density_j * h_r);
+            viscosity_x = viscosity_x + viscosity_term * (batch::load(&sorted_vx_[j]) - vx);
+            viscosity_y = viscosity_y + viscosity_term * (batch::load(&sorted_vy_[j]) - vy);
+        }
+
+        sums.pressure_x += pressure_x.sum();
+        sums.pressure_y += pressure_y.sum();
+        sums.viscosity_x += viscosity_x.sum();
+        sums.viscosity_y += viscosity_y.sum();
+
+        if constexpr (batch::width > 1)
+            force_sum<cpu_simd::scalar_batch>(s, j, end, sums);
+    }
+
+    void density_pressure_pass(size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            const uint32_t i = sorted_index_[s];
+            float sum = 0.f;
+
+            for_each_neighbor_row(particle_cell_[i], [&](uint32_t row_begin, uint32_t row_end) {
+                sum += vectorized_
+                    ? density_sum<cpu_simd::native_batch>(sorted_x_[s], sorted_y_[s], row_begin, row_end)
+                    : density_sum<cpu_simd::scalar_batch>(sorted_x_[s], sorted_y_[s], row_begin, row_end);
+            });
+
+            const float density = constants_.m * constants_.poly6 * sum;
+            const float pressure = std::max(constants_.stiffness * (density - constants_.resting_density), 0.f);
+
+            sorted_density_[s] = density_[i] = density;
+            sorted_pressure_[s] = pressure_[i] = pressure;
+        }
+    }
+
+    void force_pass(size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            const uint32_t i = sorted_index_[s];
+            const uint32_t self = static_cast<uint32_t>(s);
+            force_sums sums;
+
+            auto visit = [&](uint32_t row_begin, uint32_t row_end) {
+                if (vectorized_)
+                    force_sum<cpu_simd::native_batch>(self, row_begin, row_end, sums);
+                else
+                    force_sum<cpu_simd::scalar_batch>(self, row_begin, row_end, sums);
+            };
+
+            // the row holding i is split around it instead of masking i out lane by lane
+            for_each_neighbor_row(particle_cell_[i], [&](uint32_t row_begin, uint32_t row_end) {
+                if (self >= row_begin && self < row_end) {
+                    visit(row_begin, self);
+                    visit(self + 1, row_end);
+                }
+                else
+                    visit(row_begin, row_end);
+            });
+
+            fx_[i] = sums.pressure_x + constants_.viscosity * sums.viscosity_x + density_[i] * constants_.gravity.x;
+            fy_[i] = sums.pressure_y + constants_.viscosity * sums.viscosity_y + density_[i] * constants_.gravity.y;
+        }
+    }
+
+    // position.comp with the fixed dt over the sorted slots [begin, end); the state is updated in place since the other
+    // passes only read the copies gathered in cell order
+    void position_pass(size_t begin, size_t end) {
+        const float dt = constants_.dt;
+        const glm::vec2 box = constants_.bounding_box;
+
+        auto in_bounds = [](float coord, float boundary) {
+            return coord > -boundary && coord < boundary;
+        };
+
+        for (size_t s = begin; s < end; ++s) {
+            const uint32_t i = sorted_index_[s];
+
+            glm::vec2 velocity = glm::vec2(vx_[i], vy_[i]) + dt * glm::vec2(fx_[i], fy_[i]) / density_[i];
+            glm::vec2 position = glm::vec2(x_[i], y_[i]) + dt * velocity;
+
+            if (!in_bounds(position.x, box.x)) {
+                position.x = box.x * (position.x / std::abs(position.x));
+                velocity.x *= -1 * constants_.collision_damping;
+            }
+            else if (!in_bounds(position.y, box.y)) {
+                position.y = box.y * (position.y / std::abs(position.y));
+                velocity.y *= -1 * constants_.collision_damping;
+            }
+
+            x_[i] = position.x;
+            y_[i] = position.y;
+            vx_[i] = velocity.x;
+            vy_[i] = velocity.y;
+        }
+    }
+
+    // the block whose cells include `cell`
+    uint32_t block_of(uint32_t cell) const {
+        return static_cast<uint32_t>(std::upper_bound(block_first_cell_.begin(), block_first_cell_.end(), cell) - block_first_cell_.begin()) - 1;
+    }
+
+    // cuts the cells into blocks of about equal occupancy and links the three passes of every block: density tasks are
+    // ready at once, force tasks wait for the blocks their neighbour cells are in, position tasks for their force task
+    void build_step_graph() {
+        const uint32_t cells = grid_resolution_ * grid_resolution_;
+        const uint32_t target = std::max(static_cast<uint32_t>(x_.size() / (blocks_per_thread * thread_count())), min_block_particles);
+
+        block_first_cell_.clear();
+        block_first_cell_.push_back(0);
+
+        for (uint32_t cell = 0; cell + 1 < cells; ++cell)
+            if (cell_start_[cell + 1] - cell_start_[block_first_cell_.back()] >= target)
+                block_first_cell_.push_back(cell + 1);
+
+        block_first_cell_.push_back(cells);
+
+        const uint32_t blocks = static_cast<uint32_t>(block_first_cell_.size()) - 1;
+
+        step_graph_.clear();
+        for (uint32_t task = 0; task < 3 * blocks; ++task)
+            step_graph_.add_task();
+
+        // in row-major order the 3x3 neighbours of a cell lie at most one row and one cell away from it
+        const uint32_t reach = grid_resolution_ + 1;
+
+        for (uint32_t block = 0; block < blocks; ++block) {
+            const uint32_t first_cell = block_first_cell_[block] >= reach ? block_first_cell_[block] - reach : 0;
+            const uint32_t last_cell = std::min(block_first_cell_[block + 1] - 1 + reach, cells - 1);
+
+            for (uint32_t neighbor = block_of(first_cell); neighbor <= block_of(last_cell); ++neighbor)
+                step_graph_.add_dependency(neighbor, blocks + block);
+
+            step_graph_.add_dependency(blocks + block, 2 * blocks + block);
+        }
+    }
+
+    static constexpr uint32_t blocks_per_thread = 8; // enough spare blocks for the threads to balance by stealing
+    static constexpr uint32_t min_block_particles = 64; // below this the task overhead outweighs the work
+
+    simulation_push_constants constants_;
+    float h_;
+    uint32_t grid_resolution_;
+    bool vectorized_;
+
+    // SoA state in generation order
+    std::vector<float> x_, y_;
+    std::vector<float> vx_, vy_;
+    std::vector<float> fx_, fy_;
+    std::vector<float> density_;
+    std::vector<float> pressure_;
+
+    // rebuilt every step: the cell of every particle, the particles in cell order and where each cell starts in it
+    std::vector<uint32_t> particle_cell_;
+    std::vector<uint32_t> sorted_index_;
+    std::vector<uint32_t> cell_start_;
+    std::vector<uint32_t> cell_fill_;
+
+    // what the neighbour loops read, gathered into cell order
+    std::vector<float> sorted_x_, sorted_y_;
+    std::vector<float> sorted_vx_, sorted_vy_;
+    std::vector<float> sorted_density_;
+    std::vector<float> sorted_pressure_;
+
+    // first cell of every block plus the cell count as the end of the last one, and the tasks of the step built on them
+    std::vector<uint32_t> block_first_cell_{ 0, 0 };
+    task_graph step_graph_;
+
+    task_scheduler scheduler_;
+};
@@ -1,1153 +1,2734 @@
-#pragma once
-#include "config.hpp"
-#include "tools.hpp"
-#include <ranges>
-#include "logging.hpp"
-#include "queues.hpp"
-#include "swapchain_details.hpp"
-
-#include <set>
-#include <fstream>
-#include <sstream>
-
-constexpr size_t MAX_FRAMES_IN_FLIGHT = 2;
-
-class device_context {
-public:
-    inline device_context(const std::vector<glm::vec2> initial_positions) {
-
-        position_ssbo_size = sizeof(glm::vec2) * initial_positions.size();
-        velocity_ssbo_size = sizeof(glm::vec2) * initial_positions.size();
-        force_ssbo_size = sizeof(glm::vec2) * initial_positions.size();
-        density_ssbo_size = sizeof(float) * initial_positions.size();
-        pressure_ssbo_size = sizeof(float) * initial_positions.size();
-
-        packed_buffer_size = position_ssbo_size + velocity_ssbo_size + force_ssbo_size + density_ssbo_size + pressure_ssbo_size;
-
-        position_ssbo_offset = 0;
-        velocity_ssbo_offset = position_ssbo_size;
-        force_ssbo_offset = velocity_ssbo_offset + velocity_ssbo_size;
-        density_ssbo_offset = force_ssbo_offset + force_ssbo_size;
-        pressure_ssbo_offset = density_ssbo_offset + density_ssbo_size;
-
-        init_window();
-        init_vulkan(initial_positions);
-    }
-
-    ~device_context() {
-        destroy_vulkan();
-        destroy_window();
-    }
-
-private:
-    void init_window() {
-        glfwInit();
-        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        window_ = glfwCreateWindow(window_width_, window_height_, "", nullptr, nullptr);
-    }
-
-    void init_vulkan(const std::vector<glm::vec2> initial_positions) {
-        create_instance();
-        setup_debug_messenger();
-
-        create_surface();
-        select_physical_device();
-        create_logical_device();
-
-        create_swapchain();
-        get_swapchain_images();
-        create_swapchain_image_views();
-        create_render_pass();
-        create_swapchain_frame_buffers();
-
-        create_pipeline_cache();
-        
-        create_compute_command_pool();
-        
-        create_vertex_buffer(initial_positions);
-
-        create_graphics_pipeline_layout();
-        create_graphics_pipeline();
-        create_graphics_command_pool();
-        create_graphics_command_buffers();
-        create_semaphores();
-
-        create_descriptor_pool();
-        create_compute_descriptor_set_layout();
-        update_compute_descriptor_sets();
-        create_compute_pipeline_layout();
-        create_compute_pipelines();
-
-        create_compute_command_buffer();
-    }
-
-    void destroy_window() {
-        glfwDestroyWindow(window_);
-        glfwTerminate();
-    }
-
-    void destroy_vulkan() {
-        logical_device_.waitIdle();
- 
-        logical_device_.destroyCommandPool(compute_command_pool_);
-        
-        logical_device_.destroyDescriptorSetLayout(compute_descriptor_set_layout_);
-        
-        logical_device_.destroyPipelineLayout(compute_pipeline_layout_);
-
-        logical_device_.destroyPipeline(density_pipeline_);
-        logical_device_.destroyPipeline(force_pipeline_);
-        logical_device_.destroyPipeline(position_pipeline_);
-
-        logical_device_.destroySemaphore(render_finished_semaphore_);
-        logical_device_.destroySemaphore(image_available_semaphore_);
-
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-            logical_device_.destroySemaphore(image_available_semaphores[i]);
-            logical_device_.destroySemaphore(render_finished_semaphores[i]);
-            logical_device_.destroyFence(in_flight_fences[i]);
-        }
-
-        logical_device_.destroyCommandPool(graphics_command_pool_);
-
-        logical_device_.destroyPipeline(graphics_pipeline_);
-
-        for (const auto& handle : shader_modules_) {
-            logical_device_.destroyShaderModule(handle);
-        }
-        
-        logical_device_.destroyPipelineLayout(graphics_pipeline_layout_);
-
-        for (const auto& handle : swapchain_frame_buffers_) {
-            logical_device_.destroyFramebuffer(handle);
-        }
-
-        logical_device_.destroyBuffer(packed_particles_buffer_);
-        logical_device_.freeMemory(packed_particles_memory_);
-
-        logical_device_.destroyDescriptorPool(compute_descriptor_pool_);
-
-        logical_device_.destroyPipelineCache(global_pipeline_cache_handle);
-
-        logical_device_.destroyRenderPass(renderpass_);
-
-        for (const auto& handle : swapchain_image_views_) {
-            logical_device_.destroyImageView(handle);
-        }
-
-        logical_device_.destroySwapchainKHR(swapchain_handle);
-        instance_.destroySurfaceKHR(surface_);
-        logical_device_.destroy();
-
-        vk_tools::logging::DestroyDebugUtilsMessengerEXT(instance_, debug_messenger_);
-        instance_.destroy();
-    }
-
-    void create_instance() {
-        uint32_t glfwExtensionCount = 0;
-        auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
-
-        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-
-        std::vector<const char*> requested_layers = { "VK_LAYER_KHRONOS_validation", "VK_LAYER_LUNARG_monitor" };
-
-        auto createInfo = vk::InstanceCreateInfo{};
-        createInfo.ppEnabledExtensionNames = extensions.data();
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-        createInfo.enabledLayerCount = static_cast<uint32_t>(requested_layers.size());
-        createInfo.ppEnabledLayerNames = requested_layers.data();
-
-        VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-        populate_debug_messenger_create_info(debugCreateInfo);
-        createInfo.pNext = reinterpret_cast<VkDebugUtilsMessengerCreateInfoEXT*>(&debugCreateInfo);
-
-        instance_ = vk::createInstance(createInfo);
-    }
-
-    void setup_debug_messenger() {
-        VkDebugUtilsMessengerCreateInfoEXT create_info;
-        populate_debug_messenger_create_info(create_info);
-        vk_tools::logging::CreateDebugUtilsMessengerEXT(instance_, create_info, debug_messenger_);
-    }
-
-    void populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInfoEXT& create_info) {
-        create_info = VkDebugUtilsMessengerCreateInfoEXT{};
-        create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-
-        create_info.messageSeverity =
-            VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-            VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-            VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-        create_info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
-            | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-            VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-
-        create_info.pfnUserCallback = vk_tools::logging::debugCallback;
-    }
-
-    void create_surface() {
-        VkSurfaceKHR c_style_surface;
-
-        if (glfwCreateWindowSurface(instance_, window_, nullptr, &c_style_surface) != VK_SUCCESS)
-            throw std::runtime_error("Failed to abstract glfw surface for Vulkan.");
-
-        surface_ = c_style_surface;
-    }
-
-    void select_physical_device() {
-        physical_device_ = instance_.enumeratePhysicalDevices().front();
-    }
-
-    void create_logical_device() {
-        auto properties = physical_device_.getProperties();
-        auto indices = findQueueFamilies(physical_device_, surface_);
-
-        std::set<int> unique_queue_families = { indices.graphics_family, indices.present_family };;
-
-        std::vector< vk::DeviceQueueCreateInfo> queue_create_infos;
-
-        for (auto queue_family : unique_queue_families) {
-
-            auto queue_create_info = vk::DeviceQueueCreateInfo{};
-
-            queue_create_info.queueFamilyIndex = queue_family;
-            queue_create_info.queueCount = 1;
-
-            auto priority = 1.0f;
-            queue_create_info.pQueuePriorities = &priority;
-
-            queue_create_infos.emplace_back(queue_create_info);
-        }
-
-        auto device_create_info = vk::DeviceCreateInfo{};
-        device_create_info.pQueueCreateInfos = queue_create_infos.data();
-        device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
-
-        device_create_info.enabledExtensionCount = static_cast<uint32_t>(tools::requested_extensions.size());
-        device_create_info.ppEnabledExtensionNames = tools::requested_extensions.data();
-
-        auto features = physical_device_.getFeatures();
-        features.samplerAnisotropy = true;
-
-        device_create_info.pEnabledFeatures = &features;
-
-        logical_device_ = physical_device_.createDevice(device_create_info);
-        
-        present_queue_ = logical_device_.getQueue(indices.graphics_family, 0);
-        graphics_queue_ = logical_device_.getQueue(indices.present_family, 0);
-        compute_queue_ = logical_device_.getQueue(indices.compute_family, 0);
-
-        graphics_queue_family_index_ = indices.graphics_family;
-        compute_queue_family_index_ = indices.compute_family;
-    }
-
-    void create_swapchain() {
-        vk::PresentModeKHR swapchain_present_mode = vk::PresentModeKHR::eImmediate;
-        vk::Extent2D extent = { window_width_, window_height_ };
-
-        auto surface_capabilities = physical_device_.getSurfaceCapabilitiesKHR(surface_);
-
-        if (surface_capabilities.currentExtent.width != UINT32_MAX) {
-            extent = surface_capabilities.currentExtent;
-        }
-
-        auto surface_formats = physical_device_.getSurfaceFormatsKHR(surface_);
-
-        for (const auto& entry : surface_formats) {
-            if ((entry.format == vk::Format::eB8G8R8A8Srgb) && (entry.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)) {
-                surface_format_ = entry;
-                break;
-            }
-        }
-
-        uint32_t image_count = surface_capabilities.minImageCount + 1;
-        
-        vk::SwapchainCreateInfoKHR create_info{};        
-        create_info.surface = surface_;
-        create_info.minImageCount = image_count;
-        create_info.imageFormat = surface_format_.format;
-        create_info.imageColorSpace = surface_format_.colorSpace;
-        create_info.imageExtent = extent;
-        create_info.imageArrayLayers = 1;
-        create_info.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
-        create_info.imageSharingMode = vk::SharingMode::eExclusive;
-        create_info.queueFamilyIndexCount = 0;
-        create_info.preTransform = surface_capabilities.currentTransform;
-        create_info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
-        create_info.presentMode = swapchain_present_mode;
-        create_info.clipped = VK_TRUE;
-
-        swapchain_handle = logical_device_.createSwapchainKHR(create_info);
-
-        swapchain_extent_ = extent;
-    }
-
-    void get_swapchain_images() {
-        swapchain_images_ = logical_device_.getSwapchainImagesKHR(swapchain_handle);
-    }
-
-    void create_swapchain_image_views() {
-        swapchain_image_views_.resize(swapchain_images_.size());
-
-        for (int i = 0; i < swapchain_image_views_.size(); ++i) {
-            vk::ImageViewCreateInfo image_view_create_info{};
-
-            image_view_create_info.image = swapchain_images_[i];
-            image_view_create_info.viewType = vk::ImageViewType::e2D;
-            image_view_create_info.format = surface_format_.format;
-            image_view_create_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-            image_view_create_info.subresourceRange.levelCount = 1;
-            image_view_create_info.subresourceRange.layerCount = 1;
-
-            swapchain_image_views_[i] = logical_device_.createImageView(image_view_create_info);
-        }
-    }
-
-    void create_render_pass() {
-        vk::AttachmentDescription attachment_description{};
-
-        attachment_description.format = surface_format_.format;
-        attachment_description.initialLayout = vk::ImageLayout::eUndefined;
-        attachment_description.finalLayout = vk::ImageLayout::ePresentSrcKHR;
-        attachment_description.samples = vk::SampleCountFlagBits::e1;
-        attachment_description.loadOp = vk::AttachmentLoadOp::eClear;
-        attachment_description.storeOp = vk::AttachmentStoreOp::eStore;
-        attachment_description.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-        attachment_description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-        
-        vk::AttachmentReference color_attachment_reference{};
-
-        color_attachment_reference.layout = vk::ImageLayout::eColorAttachmentOptimal;
-        color_attachment_reference.attachment = 0;
-
-
-        vk::SubpassDescription subpass_description{};
-
-        subpass_description.colorAttachmentCount = 1;
-        subpass_description.pColorAttachments = &color_attachment_reference;
-        subpass_description.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-        
-
-        vk::RenderPassCreateInfo render_pass_create_info{};
-        render_pass_create_info.attachmentCount = 1;
-        render_pass_create_info.pAttachments = &attachment_description;
-        render_pass_create_info.subpassCount = 1;
-        render_pass_create_info.pSubpasses = &subpass_description;
-
-        renderpass_ = logical_device_.createRenderPass(render_pass_create_info);
-    }
-
-    void create_swapchain_frame_buffers() {
-        swapchain_frame_buffers_.resize(swapchain_image_views_.size());
-
-        for (size_t i = 0; i < swapchain_image_views_.size(); ++i) {
-            vk::FramebufferCreateInfo framebuffer_create_info{};
-            
-            framebuffer_create_info.renderPass = renderpass_;
-            framebuffer_create_info.height = window_height_;
-            framebuffer_create_info.width = window_width_;
-            framebuffer_create_info.attachmentCount = 1;
-            framebuffer_create_info.pAttachments = &swapchain_image_views_[i];
-            framebuffer_create_info.layers = 1;
-
-            swapchain_frame_buffers_[i] = logical_device_.createFramebuffer(framebuffer_create_info);
-        }
-    }
-
-    void create_descriptor_pool() {
-
-        vk::DescriptorPoolSize descriptor_pool_size{};
-        descriptor_pool_size.descriptorCount = 5;
-        descriptor_pool_size.type = vk::DescriptorType::eStorageBuffer;
-
-        vk::DescriptorPoolCreateInfo create_info{};
-        create_info.maxSets = 1;
-        create_info.poolSizeCount = 1;
-        create_info.pPoolSizes = &descriptor_pool_size;
-
-        compute_descriptor_pool_ = logical_device_.createDescriptorPool(create_info);
-    }
-    
-    void create_pipeline_cache() {
-        VkPipelineCacheCreateInfo create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
-            NULL,
-            0,
-            0,
-            NULL
-        };
-
-        global_pipeline_cache_handle = logical_device_.createPipelineCache(create_info);
-    }
-
-    void create_vertex_buffer(const std::vector<glm::vec2> &positions) {
-        vk::BufferCreateInfo packed_particles_buffer_create_info{};
-
-        packed_particles_buffer_create_info.size = packed_buffer_size;
-        packed_particles_buffer_create_info.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
-        packed_particles_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
-
-        packed_particles_buffer_ = logical_device_.createBuffer(packed_particles_buffer_create_info);
-
-        auto position_buffer_memory_requirements = logical_device_.getBufferMemoryRequirements(packed_particles_buffer_);
-        
-        vk::MemoryAllocateInfo particle_buffer_memory_allocation_info{};
-        particle_buffer_memory_allocation_info.allocationSize = position_buffer_memory_requirements.size;
-        particle_buffer_memory_allocation_info.memoryTypeIndex = get_memory_type_index(position_buffer_memory_requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-        packed_particles_memory_ = logical_device_.allocateMemory(particle_buffer_memory_allocation_info);
-
-        logical_device_.bindBufferMemory(packed_particles_buffer_, packed_particles_memory_, 0);
-
-        vk::BufferCreateInfo staging_buffer_create_info{};
-        staging_buffer_create_info.size = packed_buffer_size;
-        staging_buffer_create_info.usage = vk::BufferUsageFlagBits::eTransferSrc;
-        staging_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
-
-        auto staging_buffer_handle = logical_device_.createBuffer(staging_buffer_create_info);
-        auto staging_buffer_memory_requirements = logical_device_.getBufferMemoryRequirements(staging_buffer_handle);
-
-        vk::MemoryAllocateInfo alloc_info{};
-        alloc_info.allocationSize = staging_buffer_memory_requirements.size;
-        alloc_info.memoryTypeIndex = get_memory_type_index(staging_buffer_memory_requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-
-        auto staging_buffer_memory_device_handle = logical_device_.allocateMemory(alloc_info);
-
-        logical_device_.bindBufferMemory(staging_buffer_handle, staging_buffer_memory_device_handle, 0);
-
-        auto mapped_memory = logical_device_.mapMemory(staging_buffer_memory_device_handle, 0, staging_buffer_memory_requirements.size);
-
-        std::memset(mapped_memory, 0, packed_buffer_size);
-        std::memcpy(mapped_memory, positions.data(), position_ssbo_size);
-
-        logical_device_.unmapMemory(staging_buffer_memory_device_handle);
-
-        vk::CommandBufferAllocateInfo command_buffer_allocate_info{};
-        command_buffer_allocate_info.commandBufferCount = 1;
-        command_buffer_allocate_info.commandPool = compute_command_pool_;
-        command_buffer_allocate_info.level = vk::CommandBufferLevel::ePrimary;
-
-        auto copy_command_buffer_handle = logical_device_.allocateCommandBuffers(command_buffer_allocate_info).front();
-
-        vk::CommandBufferBeginInfo begin_info{};
-        begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-
-        copy_command_buffer_handle.begin(begin_info);
-
-        vk::BufferCopy buffer_copy_region{};
-        buffer_copy_region.dstOffset = 0;
-        buffer_copy_region.srcOffset = 0;
-        buffer_copy_region.size = staging_buffer_memory_requirements.size;
-
-        copy_command_buffer_handle.copyBuffer(staging_buffer_handle, packed_particles_buffer_, buffer_copy_region);
-
-        copy_command_buffer_handle.end();
-
-        vk::SubmitInfo submit_info{};
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &copy_command_buffer_handle;
-
-        compute_queue_.submit(submit_info);
-
-        compute_queue_.waitIdle();
-
-        logical_device_.freeCommandBuffers(compute_command_pool_, { copy_command_buffer_handle });
-        logical_device_.freeMemory(staging_buffer_memory_device_handle);
-        logical_device_.destroyBuffer(staging_buffer_handle);
-    }
-
-    void create_graphics_pipeline_layout() {
-        vk::PipelineLayoutCreateInfo create_info{};
-        graphics_pipeline_layout_ = logical_device_.createPipelineLayout(create_info);
-    }
-
-    void create_graphics_pipeline() {
-        std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_infos;
-
-        VkShaderModule vertex_shader_module = create_shader_module_from_file("particle.vert.spv");
-
-        VkShaderModule fragment_shader_module = create_shader_module_from_file("particle.frag.spv");
-
-        VkPipelineShaderStageCreateInfo vertex_shader_stage_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            NULL,
-            0,
-            VK_SHADER_STAGE_VERTEX_BIT,
-            vertex_shader_module,
-            "main",
-            NULL
-        };
-
-        VkPipelineShaderStageCreateInfo fragment_shader_stage_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            NULL,
-            0,
-            VK_SHADER_STAGE_FRAGMENT_BIT,
-            fragment_shader_module,
-            "main",
-            NULL
-        };
-
-        shader_stage_create_infos.push_back(vertex_shader_stage_create_info);
-        shader_stage_create_infos.push_back(fragment_shader_stage_create_info);
-
-        VkVertexInputBindingDescription vertex_input_binding_description
-        {
-            0,
-            sizeof(glm::vec2),
-            VK_VERTEX_INPUT_RATE_VERTEX
-        };
-
-        VkVertexInputAttributeDescription vertex_input_attribute_description
-        {
-            0,
-            0,
-            VK_FORMAT_R32G32_SFLOAT,
-            0
-        };
-
-        VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            NULL,
-            0,
-            1,
-            &vertex_input_binding_description,
-            1,
-            &vertex_input_attribute_description
-        };
-
-        VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
-            VK_FALSE
-        };
-
-        VkViewport viewport
-        {
-            0,
-            0,
-            static_cast<float>(window_width_),
-            static_cast<float>(window_height_),
-            0,
-            1
-        };
-
-        VkRect2D scissor
-        {
-            { 0, 0 },
-            { window_width_, window_height_ }
-        };
-
-        VkPipelineViewportStateCreateInfo viewport_state_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-            NULL,
-            0,
-            1,
-            &viewport,
-            1,
-            &scissor
-        };
-
-        VkPipelineRasterizationStateCreateInfo rasterization_state_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_FALSE,
-            VK_FALSE,
-            VK_POLYGON_MODE_FILL,
-            VK_CULL_MODE_NONE,
-            VK_FRONT_FACE_COUNTER_CLOCKWISE,
-            VK_FALSE,
-            0,
-            0,
-            0,
-            1
-        };
-
-        VkPipelineMultisampleStateCreateInfo multisample_state_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_SAMPLE_COUNT_1_BIT,
-            VK_FALSE,
-            0,
-            NULL,
-            VK_FALSE,
-            VK_FALSE
-        };
-
-        VkPipelineColorBlendAttachmentState color_blend_attachment
-        {
-            VK_FALSE,
-            VK_BLEND_FACTOR_ONE,
-            VK_BLEND_FACTOR_ZERO,
-            VK_BLEND_OP_ADD,
-            VK_BLEND_FACTOR_ONE,
-            VK_BLEND_FACTOR_ZERO,
-            VK_BLEND_OP_ADD,
-            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
-        };
-
-        VkPipelineColorBlendStateCreateInfo color_blend_state_create_info
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_FALSE,
-            VK_LOGIC_OP_COPY,
-            1,
-            &color_blend_attachment,
-            {0, 0, 0, 0}
-        };
-
-        VkGraphicsPipelineCreateInfo graphics_pipeline_create_info
-        {
-            VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            NULL,
-            0,
-            static_cast<uint32_t>(shader_stage_create_infos.size()),
-            shader_stage_create_infos.data(),
-            &vertex_input_state_create_info,
-            &input_assembly_state_create_info,
-            NULL,
-            &viewport_state_create_info,
-            &rasterization_state_create_info,
-            &multisample_state_create_info,
-            NULL,
-            &color_blend_state_create_info,
-            NULL,
-            graphics_pipeline_layout_,
-            renderpass_,
-            0,
-            VK_NULL_HANDLE,
-            -1
-        };
-
-        graphics_pipeline_ = logical_device_.createGraphicsPipeline(global_pipeline_cache_handle, graphics_pipeline_create_info).value;
-    }
-
-    void create_graphics_pipeline1() {
-        std::vector<vk::PipelineShaderStageCreateInfo> shader_stage_create_infos;
-
-        auto vertex_shader_module = create_shader_module_from_file("particle.vert.spv");
-        auto fragment_shader_module = create_shader_module_from_file("particle.frag.spv");
-
-        vk::PipelineShaderStageCreateInfo vertex_shader_stage_create_info{};
-        vertex_shader_stage_create_info.stage = vk::ShaderStageFlagBits::eVertex;
-        vertex_shader_stage_create_info.module = vertex_shader_module;
-        vertex_shader_stage_create_info.pName = "main";
-
-        vk::PipelineShaderStageCreateInfo fragment_shader_stage_create_info{};
-        fragment_shader_stage_create_info.stage = vk::ShaderStageFlagBits::eFragment;
-        fragment_shader_stage_create_info.module = fragment_shader_module;
-        fragment_shader_stage_create_info.pName = "main";
-
-        shader_stage_create_infos.push_back(vertex_shader_stage_create_info);
-        shader_stage_create_infos.push_back(fragment_shader_stage_create_info);
-
-        vk::VertexInputBindingDescription vertex_input_binding_description{};
-        vertex_input_binding_description.binding = 0;
-        vertex_input_binding_description.inputRate = vk::VertexInputRate::eVertex;
-        vertex_input_binding_description.stride = sizeof(glm::vec2);
-
-        vk::VertexInputAttributeDescription vertex_input_attribute_description{};
-        vertex_input_attribute_description.format = vk::Format::eR32G32Sfloat;
-        vertex_input_attribute_description.location = 0;
-        vertex_input_attribute_description.binding = 0;
-        vertex_input_attribute_description.offset = 0;
-
-        vk::PipelineVertexInputStateCreateInfo vertex_input_state_create_info{};
-        vertex_input_state_create_info.vertexAttributeDescriptionCount = 1;
-        vertex_input_state_create_info.pVertexAttributeDescriptions = &vertex_input_attribute_description;
-        vertex_input_state_create_info.vertexBindingDescriptionCount = 1;
-        vertex_input_state_create_info.pVertexBindingDescriptions = &vertex_input_binding_description;
-        
-        vk::PipelineInputAssemblyStateCreateInfo input_assembly_state_create_info{};
-        input_assembly_state_create_info.topology = vk::PrimitiveTopology::ePointList;
-        input_assembly_state_create_info.primitiveRestartEnable = false;
-
-        vk::Viewport viewport{};
-        viewport.height = static_cast<float>(window_height_);
-        viewport.width = static_cast<float>(window_width_);
-        viewport.x = 0;
-        viewport.y = 0;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        vk::Rect2D scissor{};
-        scissor.offset = vk::Offset2D{ 0, 0 };
-        scissor.extent = vk::Extent2D{ window_width_, window_height_ };
-
-        vk::PipelineViewportStateCreateInfo viewport_state_create_info{};
-        viewport_state_create_info.scissorCount = 1;
-        viewport_state_create_info.pScissors = &scissor;
-        viewport_state_create_info.viewportCount = 1;
-        viewport_state_create_info.pViewports = &viewport;
-
-        vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info{};
-        rasterization_state_create_info.cullMode = vk::CullModeFlagBits::eNone;
-        rasterization_state_create_info.frontFace = vk::FrontFace::eCounterClockwise;
-        rasterization_state_create_info.polygonMode = vk::PolygonMode::eFill;
-        rasterization_state_create_info.lineWidth = 1;
-
-        vk::PipelineMultisampleStateCreateInfo multisample_state_create_info{};
-        multisample_state_create_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
-
-        vk::PipelineColorBlendAttachmentState color_blend_attachment{};
-        color_blend_attachment.blendEnable = false;
-        color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
-        color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eZero;
-        color_blend_attachment.colorBlendOp = vk::BlendOp::eAdd;
-        color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
-        color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
-        color_blend_attachment.alphaBlendOp = vk::BlendOp::eAdd;
-        color_blend_attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-
-        vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info{};
-        color_blend_state_create_info.logicOp = vk::LogicOp::eCopy;
-        color_blend_state_create_info.attachmentCount = 1;
-        color_blend_state_create_info.pAttachments = &color_blend_attachment;
-        color_blend_state_create_info.blendConstants[0] = 0.0f;
-        color_blend_state_create_info.blendConstants[1] = 0.0f;
-        color_blend_state_create_info.blendConstants[2] = 0.0f;
-        color_blend_state_create_info.blendConstants[3] = 0.0f;
-
-        vk::GraphicsPipelineCreateInfo graphics_pipeline_create_info{};
-
-        graphics_pipeline_create_info.stageCount = static_cast<uint32_t>(shader_stage_create_infos.size());
-        graphics_pipeline_create_info.pStages = shader_stage_create_infos.data();
-        graphics_pipeline_create_info.pVertexInputState = &vertex_input_state_create_info;
-        graphics_pipeline_create_info.pInputAssemblyState = &input_assembly_state_create_info;
-        graphics_pipeline_create_info.pViewportState = &viewport_state_create_info;
-        graphics_pipeline_create_info.pMultisampleState = &multisample_state_create_info;
-        graphics_pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
-        graphics_pipeline_create_info.renderPass = renderpass_;
-        graphics_pipeline_create_info.basePipelineIndex = -1;
-        graphics_pipeline_create_info.layout = graphics_pipeline_layout_;
-
-        graphics_pipeline_ = logical_device_.createGraphicsPipeline({}, graphics_pipeline_create_info).value;
-    }
-    
-    void create_graphics_command_pool() {
-        vk::CommandPoolCreateInfo create_info{};
-        create_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-        create_info.queueFamilyIndex = graphics_queue_family_index_;
-
-        graphics_command_pool_ = logical_device_.createCommandPool(create_info);
-    }
-
-    void create_graphics_command_buffers() {
-        graphics_command_buffers_.resize(swapchain_frame_buffers_.size());
-
-        vk::CommandBufferAllocateInfo alloc_info{};
-        alloc_info.commandPool = graphics_command_pool_;
-        alloc_info.level = vk::CommandBufferLevel::ePrimary;
-        alloc_info.commandBufferCount = static_cast<uint32_t>(graphics_command_buffers_.size());
- 
-        graphics_command_buffers_ = logical_device_.allocateCommandBuffers(alloc_info);
-    }
-
-    void create_semaphores() {
-        vk::SemaphoreCreateInfo semaphore_info{};
-
-        vk::FenceCreateInfo fence_info{};
-        fence_info.flags = vk::FenceCreateFlagBits::eSignaled;
-
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-            image_available_semaphores.emplace_back(logical_device_.createSemaphore(semaphore_info));
-            render_finished_semaphores.emplace_back(logical_device_.createSemaphore(semaphore_info));
-            in_flight_fences.emplace_back(logical_device_.createFence(fence_info));
-        }
-
-        vk::SemaphoreCreateInfo semaphore_create_info{};
-        image_available_semaphore_ = logical_device_.createSemaphore(semaphore_create_info);
-        render_finished_semaphore_ = logical_device_.createSemaphore(semaphore_create_info);
-    }
-
-    void create_compute_descriptor_set_layout() {
-        vk::DescriptorSetLayoutBinding position = {};
-        position.binding = 0;
-        position.descriptorCount = 1;
-        position.descriptorType = vk::DescriptorType::eStorageBuffer;
-        position.stageFlags = vk::ShaderStageFlagBits::eCompute;
-
-        vk::DescriptorSetLayoutBinding velocity = {};
-        velocity.binding = 1;
-        velocity.descriptorCount = 1;
-        velocity.descriptorType = vk::DescriptorType::eStorageBuffer;
-        velocity.stageFlags = vk::ShaderStageFlagBits::eCompute;
-
-        vk::DescriptorSetLayoutBinding force = {};
-        force.binding = 2;
-        force.descriptorCount = 1;
-        force.descriptorType = vk::DescriptorType::eStorageBuffer;
-        force.stageFlags = vk::ShaderStageFlagBits::eCompute;
-
-        vk::DescriptorSetLayoutBinding density = {};
-        density.binding = 3;
-        density.descriptorCount = 1;
-        density.descriptorType = vk::DescriptorType::eStorageBuffer;
-        density.stageFlags = vk::ShaderStageFlagBits::eCompute;
-
-        vk::DescriptorSetLayoutBinding pressure = {};
-        pressure.binding = 4;
-        pressure.descriptorCount = 1;
-        pressure.descriptorType = vk::DescriptorType::eStorageBuffer;
-        pressure.stageFlags = vk::ShaderStageFlagBits::eCompute;
-
-        vk::DescriptorSetLayoutBinding bindings[] = { position, velocity, force, density, pressure };
-
-        vk::DescriptorSetLayoutCreateInfo create_info{};
-        create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
-        create_info.pBindings = bindings;
-
-        compute_descriptor_set_layout_ = logical_device_.createDescriptorSetLayout(create_info);
-    }
-
-    void update_compute_descriptor_sets() {
-        vk::DescriptorSetAllocateInfo descriptor_set_allocate_info
-        {
-            compute_descriptor_pool_,
-            1,
-            &compute_descriptor_set_layout_
-        };
-
-        logical_device_.allocateDescriptorSets(&descriptor_set_allocate_info, &compute_descriptor_set_);
-
-        VkDescriptorBufferInfo descriptor_buffer_infos[]
-        {
-            {
-                packed_particles_buffer_,
-                position_ssbo_offset,
-                position_ssbo_size
-            },
-            {
-                packed_particles_buffer_,
-                velocity_ssbo_offset,
-                velocity_ssbo_size
-            },
-            {
-                packed_particles_buffer_,
-                force_ssbo_offset,
-                force_ssbo_size
-            },
-            {
-                packed_particles_buffer_,
-                density_ssbo_offset,
-                density_ssbo_size
-            },
-            {
-                packed_particles_buffer_,
-                pressure_ssbo_offset,
-                pressure_ssbo_size
-            }
-        };
-
-        VkWriteDescriptorSet write_descriptor_sets[]
-        {
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                NULL,
-                compute_descriptor_set_,
-                0,
-                0,
-                1,
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                VK_NULL_HANDLE,
-                &descriptor_buffer_infos[0],
-                VK_NULL_HANDLE
-            },
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                NULL,
-                compute_descriptor_set_,
-                1,
-                0,
-                1,
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                VK_NULL_HANDLE,
-                &descriptor_buffer_infos[1],
-                VK_NULL_HANDLE
-            },
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                NULL,
-                compute_descriptor_set_,
-                2,
-                0,
-                1,
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                VK_NULL_HANDLE,
-                &descriptor_buffer_infos[2],
-                VK_NULL_HANDLE
-            },
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                NULL,
-                compute_descriptor_set_,
-                3,
-                0,
-                1,
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                VK_NULL_HANDLE,
-                &descriptor_buffer_infos[3],
-                VK_NULL_HANDLE
-            },
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                NULL,
-                compute_descriptor_set_,
-                4,
-                0,
-                1,
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                VK_NULL_HANDLE,
-                &descriptor_buffer_infos[4],
-                VK_NULL_HANDLE
-            }
-        };
-        vkUpdateDescriptorSets(logical_device_, 5, write_descriptor_sets, 0, NULL);
-    }
-
-    void update_compute_descriptor_sets1() {
-        vk::DescriptorSetAllocateInfo alloc_info{};
-        alloc_info.descriptorSetCount = 1;
-        alloc_info.pSetLayouts = &compute_descriptor_set_layout_;
-        alloc_info.descriptorPool = compute_descriptor_pool_;
-
-        compute_descriptor_set_ = logical_device_.allocateDescriptorSets(alloc_info).front();
-
-        vk::DescriptorBufferInfo position{};
-        position.buffer = packed_particles_buffer_;
-        position.offset = position_ssbo_offset;
-        position.range = position_ssbo_size;
-
-        vk::DescriptorBufferInfo velocity{};
-        velocity.buffer = packed_particles_buffer_;
-        velocity.offset = velocity_ssbo_offset;
-        velocity.range = velocity_ssbo_size;
-
-        vk::DescriptorBufferInfo force{};
-        force.buffer = packed_particles_buffer_;
-        force.offset = force_ssbo_offset;
-        force.range = force_ssbo_size;
-
-        vk::DescriptorBufferInfo density{};
-        density.buffer = packed_particles_buffer_;
-        density.offset = density_ssbo_offset;
-        density.range = density_ssbo_size;
-
-        vk::DescriptorBufferInfo pressure{};
-        pressure.buffer = packed_particles_buffer_;
-        pressure.offset = pressure_ssbo_offset;
-        pressure.range = pressure_ssbo_size;
-
-        vk::WriteDescriptorSet write_position{};
-        write_position.descriptorCount = 1;
-        write_position.dstBinding = 0;
-        write_position.dstSet = compute_descriptor_set_;
-        write_position.pBufferInfo = &position;
-
-        vk::WriteDescriptorSet write_velocity{};
-        write_velocity.descriptorCount = 1;
-        write_velocity.dstBinding = 1;
-        write_velocity.dstSet = compute_descriptor_set_;
-        write_velocity.pBufferInfo = &velocity;
-
-        vk::WriteDescriptorSet write_force{};
-        write_force.descriptorCount = 1;
-        write_force.dstBinding = 2;
-        write_force.dstSet = compute_descriptor_set_;
-        write_force.pBufferInfo = &force;
-
-        vk::WriteDescriptorSet write_density{};
-        write_density.descriptorCount = 1;
-        write_density.dstBinding = 3;
-        write_density.dstSet = compute_descriptor_set_;
-        write_density.pBufferInfo = &density;
-
-        vk::WriteDescriptorSet write_pressure{};
-        write_pressure.descriptorCount = 1;
-        write_pressure.dstBinding = 4;
-        write_pressure.dstSet = compute_descriptor_set_;
-        write_pressure.pBufferInfo = &pressure;
-
-        vk::WriteDescriptorSet write_descriptor_sets[] = { write_position, write_velocity, write_force, write_density, write_pressure };
-
-        logical_device_.updateDescriptorSets(write_descriptor_sets, {});
-    }
-    
-    void create_compute_pipeline_layout() {
-        vk::PipelineLayoutCreateInfo create_info{};
-        create_info.pSetLayouts = &compute_descriptor_set_layout_;
-        create_info.setLayoutCount = 1;
-        
-        compute_pipeline_layout_ = logical_device_.createPipelineLayout(create_info);
-    }
-
-    void create_compute_pipelines() {
-        auto compute_density_pressure_shader_module = create_shader_module_from_file("density_pressure.comp.spv");
-
-        vk::PipelineShaderStageCreateInfo compute_shader_stage_create_info{};
-        compute_shader_stage_create_info.pName = "main";
-        compute_shader_stage_create_info.stage = vk::ShaderStageFlagBits::eCompute;
-        compute_shader_stage_create_info.module = compute_density_pressure_shader_module;
-
-        vk::ComputePipelineCreateInfo compute_pipeline_create_info{};
-        compute_pipeline_create_info.stage = compute_shader_stage_create_info;
-        compute_pipeline_create_info.layout = compute_pipeline_layout_;
-
-        density_pipeline_ = logical_device_.createComputePipeline(global_pipeline_cache_handle, compute_pipeline_create_info).value;
-
-        auto compute_force_shader_module = create_shader_module_from_file("force.comp.spv");
-        compute_shader_stage_create_info.module = compute_force_shader_module;
-        compute_pipeline_create_info.stage = compute_shader_stage_create_info;
-
-        force_pipeline_ = logical_device_.createComputePipeline(global_pipeline_cache_handle, compute_pipeline_create_info).value;
-
-        auto integrate_shader_module = create_shader_module_from_file("position.comp.spv");
-        compute_shader_stage_create_info.module = integrate_shader_module;
-        compute_pipeline_create_info.stage = compute_shader_stage_create_info;
-
-        position_pipeline_ = logical_device_.createComputePipeline(global_pipeline_cache_handle, compute_pipeline_create_info).value;
-    }
-
-    void create_compute_command_pool() {
-        vk::CommandPoolCreateInfo create_info{};
-        create_info.queueFamilyIndex = compute_queue_family_index_;
-
-        compute_command_pool_ = logical_device_.createCommandPool(create_info);
-    }
-
-    void create_compute_command_buffer() {
-        vk::CommandBufferAllocateInfo alloc_info{};
-        alloc_info.commandPool = compute_command_pool_;
-        alloc_info.commandBufferCount = 1;
-        alloc_info.level = vk::CommandBufferLevel::ePrimary;
-
-        compute_command_buffer_ = logical_device_.allocateCommandBuffers(alloc_info).front();
-    }
-
-private:
-    vk::ShaderModule create_shader_module_from_file(const std::string& path_to_file) {
-        std::ifstream shader_file(path_to_file, std::ios::ate | std::ios::binary);
-        if (!shader_file) throw std::runtime_error("shader file load error");
-
-        size_t shader_file_size = (size_t)shader_file.tellg();
-        std::vector<char> shader_code(shader_file_size);
-        shader_file.seekg(0);
-        shader_file.read(shader_code.data(), shader_file_size);
-        shader_file.close();
-
-        vk::ShaderModuleCreateInfo create_info{};
-        create_info.codeSize = shader_code.size();
-        create_info.pCode = reinterpret_cast<const uint32_t*>(shader_code.data());
-
-        auto shader_module = logical_device_.createShaderModule(create_info);
-
-        shader_modules_.push_back(shader_module);
-
-        return shader_module;
-    }
-
-    uint32_t get_memory_type_index(uint32_t supported_types_mask, vk::MemoryPropertyFlags properties) {
-        auto supported_properties = physical_device_.getMemoryProperties();
-        for (uint32_t i = 0; i < supported_properties.memoryTypeCount; ++i)
-            if (supported_types_mask & (1 << i)
-                &&
-                (supported_properties.memoryTypes[i].propertyFlags & properties))
-                return i;
-
-        throw std::runtime_error("failed to find suitable memory type!");
-    }
-
-public:
-    GLFWwindow* window_;
-    uint32_t window_height_ = 900;
-    uint32_t window_width_ = 1800;
-
-    vk::Instance instance_;
-    VkDebugUtilsMessengerEXT debug_messenger_;
-
-    vk::PhysicalDevice physical_device_;
-    vk::Device logical_device_;
-    vk::SurfaceKHR surface_;
-    vk::SurfaceFormatKHR surface_format_;
-
-    vk::SwapchainKHR swapchain_handle;
-    std::vector<vk::Image> swapchain_images_;
-    std::vector<vk::ImageView> swapchain_image_views_;
-    std::vector<vk::Framebuffer> swapchain_frame_buffers_;
-    vk::Extent2D swapchain_extent_;
-
-    std::vector<vk::ShaderModule> shader_modules_;
-
-    vk::RenderPass renderpass_;
-
-    uint32_t graphics_queue_family_index_;
-    uint32_t compute_queue_family_index_;
-
-    vk::Queue present_queue_;
-    vk::Queue graphics_queue_;
-    vk::Queue compute_queue_;
-
-    vk::CommandPool graphics_command_pool_;
-    std::vector<vk::CommandBuffer> graphics_command_buffers_;
-    
-    vk::CommandPool compute_command_pool_;
-    vk::CommandBuffer compute_command_buffer_;
-
-    vk::DescriptorPool compute_descriptor_pool_;
-
-    vk::DescriptorSetLayout compute_descriptor_set_layout_;
-    vk::DescriptorSet compute_descriptor_set_;
-
-    vk::PipelineCache global_pipeline_cache_handle;
-
-    vk::PipelineLayout graphics_pipeline_layout_;
-    vk::Pipeline graphics_pipeline_;
-
-    vk::PipelineLayout compute_pipeline_layout_;
-    vk::Pipeline density_pipeline_;
-    vk::Pipeline force_pipeline_;
-    vk::Pipeline position_pipeline_;
-
-
-    vk::Buffer packed_particles_buffer_;
-    vk::DeviceMemory packed_particles_memory_;
-
-    vk::Semaphore image_available_semaphore_;
-    vk::Semaphore render_finished_semaphore_;
-
-    uint32_t image_index_;
-
-    std::vector<vk::Semaphore> image_available_semaphores; //an image has been acquired from the swapchain and is ready for rendering
-    std::vector<vk::Semaphore> render_finished_semaphores; //rendering has finished 
-    std::vector<vk::Fence> in_flight_fences; //to make sure only one frame is rendering at a time
-
-    size_t position_ssbo_size;
-    size_t velocity_ssbo_size;
-    size_t force_ssbo_size;
-    size_t density_ssbo_size;
-    size_t pressure_ssbo_size;
-
-    size_t packed_buffer_size;
-    
-    size_t position_ssbo_offset;
-    size_t velocity_ssbo_offset;
-    size_t force_ssbo_offset;
-    size_t density_ssbo_offset;
-    size_t pressure_ssbo_offset;
+#pragma once
+#include "config.hpp"
+#include "tools.hpp"
+#include <ranges>
+#include "logging.hpp"
+#include "queues.hpp"
+#include "swapchain_details.hpp"
+#include "settings.hpp"
+#include "fluid.hpp"
+#include "profiler.hpp"
+#include "checkpoint.hpp"
+#include "memory_allocator.hpp"
+#include "staging_arena.hpp"
+
+// generated by embed_shaders.py, which has to run before the build; no compiled SPIR-V is checked in
+#if !__has_include("embedded_shaders.hpp")
+#error "src/embedded_shaders.hpp is missing, run python3 src/embed_shaders.py before building"
+#endif
+#include "embedded_shaders.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <set>
+#include <array>
+#include <span>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <sstream>
+
+constexpr size_t MAX_FRAMES_IN_FLIGHT = 2;
+
+// mirrors the std430 neighbor_list_status block of the neighbor list shaders
+struct neighbor_list_status {
+    uint32_t rebuild_dispatch[3];
+    uint32_t force_rebuild;
+    uint32_t scan_dispatch[3];
+    uint32_t max_displacement;
+    float skin;
+    uint32_t max_neighbors;
+    uint32_t rebuild_count;
+    uint32_t overflow_count;
+    uint32_t step_count;
+};
+
+// mirrors the std430 time_step_state block of position.comp and the time step shaders
+struct time_step_state {
+    float dt;
+    uint32_t max_speed;
+    uint32_t max_acceleration;
+    float dt_min;
+    float dt_max;
+    float cfl_number;
+    float force_factor;
+    uint32_t step_count;
+    float simulated_time;
+    float simulated_time_compensation; // Kahan summation term of time_step_update.comp
+};
+
+// mirror the std430 particle_emitter and particle_sink structs of the emitter and sink shaders
+struct particle_emitter {
+    glm::vec2 origin;
+    glm::vec2 velocity;
+    uint32_t row_size;
+    float travelled;
+};
+
+struct particle_sink {
+    glm::vec2 lower;
+    glm::vec2 upper;
+};
+
+// mirrors the std430 particle_count_state block; the per-particle shaders only declare `alive`
+struct particle_count_state {
+    uint32_t alive; // live particles, packed at the front of every particle array
+    uint32_t capacity;
+    uint32_t removed; // by the sinks during the step in flight
+    uint32_t emitted;
+    uint32_t dispatch[3]; // indirect arguments of the per-particle passes
+    uint32_t state; // the ping-pong half the last step wrote, flipped by particle_count_update
+    uint32_t draw[2][4]; // VkDrawIndirectCommand of each ping-pong half
+    uint32_t emitter_count;
+    uint32_t sink_count;
+    uint32_t total_emitted;
+    uint32_t total_removed;
+    uint32_t dropped; // particles an emitter had no free slot for
+    uint32_t padding;
+    particle_emitter emitters[max_emitters];
+    particle_sink sinks[max_sinks];
+};
+
+static_assert(offsetof(particle_count_state, dispatch) == 16 && offsetof(particle_count_state, draw) == 32, "must match the std430 block");
+static_assert(offsetof(particle_count_state, emitters) == 88 && sizeof(particle_emitter) == 24 && offsetof(particle_count_state, sinks) == 184,
+    "must match the std430 block");
+
+// mirrors the head of the culled_draw block of particle_cull.comp, the visible indices follow it
+struct culled_draw_arguments {
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t first_instance;
+};
+
+static_assert(sizeof(culled_draw_arguments) == sizeof(VkDrawIndexedIndirectCommand), "read as the arguments of the indexed indirect draw");
+
+// mirrors the view_parameters push constant block of particle_cull.comp; particle.vert declares the first three fields
+struct view_push_constants {
+    glm::vec2 center;
+    glm::vec2 scale;
+    float point_size;
+    uint32_t drawn_state;
+    glm::vec2 extent;
+    uint32_t bins_x;
+    uint32_t bins_y;
+    float bin_size;
+    uint32_t bin_limit;
+};
+
+static_assert(sizeof(view_push_constants) == 48, "must match the std430 push constant block");
+
+class device_context {
+public:
+    inline device_context(const std::vector<glm::vec2> initial_positions, const simulation_settings& settings) : settings_(settings) {
+        if (!settings_.headless)
+            init_window();
+
+        init_vulkan(initial_positions);
+    }
+
+    ~device_context() {
+        destroy_vulkan();
+        destroy_window();
+    }
+
+private:
+    // runs once the logical device exists, since the particle layout depends on 16-bit storage support; every array has a
+    // slot for each particle the capacity allows, the live ones are kept packed at the front
+    void compute_buffer_layout() {
+        const size_t capacity = settings_.capacity();
+
+        // positions stay fp32: they are the vertex buffer and the grid key, and fp16 resolves only a tenth of a radius near the walls
+        size_t velocity_element_size = settings_.compact_storage ? 2 * sizeof(uint16_t) : sizeof(glm::vec2);
+        size_t scalar_element_size = settings_.compact_storage ? sizeof(uint16_t) : sizeof(float);
+
+        position_ssbo_size = sizeof(glm::vec2) * capacity;
+        velocity_ssbo_size = velocity_element_size * capacity;
+        force_ssbo_size = sizeof(glm::vec2) * capacity;
+        density_ssbo_size = scalar_element_size * capacity;
+        pressure_ssbo_size = scalar_element_size * capacity;
+
+        position_ssbo_offset = 0;
+        velocity_ssbo_offset = tools::align_up(position_ssbo_offset + position_ssbo_size, tools::storage_buffer_alignment);
+        force_ssbo_offset = tools::align_up(velocity_ssbo_offset + velocity_ssbo_size, tools::storage_buffer_alignment);
+        density_ssbo_offset = tools::align_up(force_ssbo_offset + force_ssbo_size, tools::storage_buffer_alignment);
+        pressure_ssbo_offset = tools::align_up(density_ssbo_offset + density_ssbo_size, tools::storage_buffer_alignment);
+
+        // the second half of the position/velocity ping-pong pair, see position_offset()
+        swap_position_ssbo_offset = tools::align_up(pressure_ssbo_offset + pressure_ssbo_size, tools::storage_buffer_alignment);
+        swap_velocity_ssbo_offset = tools::align_up(swap_position_ssbo_offset + position_ssbo_size, tools::storage_buffer_alignment);
+
+        packed_buffer_size = swap_velocity_ssbo_offset + velocity_ssbo_size;
+
+        grid_resolution_ = settings_.params.grid_resolution();
+
+        if (settings_.neighbor_search == neighbor_search_mode::hashed_grid) {
+            // the table only has to hold the occupied cells, so it scales with the particle count instead of the domain
+            grid_cell_count_ = settings_.hash_table_capacity;
+
+            if (grid_cell_count_ == 0)
+                for (grid_cell_count_ = 1; grid_cell_count_ < 2 * capacity; grid_cell_count_ <<= 1);
+
+            if (grid_cell_count_ & (grid_cell_count_ - 1))
+                throw std::runtime_error("hash table capacity must be a power of two");
+        }
+        else {
+            grid_cell_count_ = grid_resolution_ * grid_resolution_;
+        }
+
+        cell_count_ssbo_size = sizeof(uint32_t) * grid_cell_count_;
+        cell_start_ssbo_size = sizeof(uint32_t) * grid_cell_count_;
+        particle_cell_ssbo_size = sizeof(glm::uvec2) * capacity;
+        sorted_index_ssbo_size = sizeof(uint32_t) * capacity;
+
+        cell_count_ssbo_offset = 0;
+        cell_start_ssbo_offset = tools::align_up(cell_count_ssbo_offset + cell_count_ssbo_size, tools::storage_buffer_alignment);
+        particle_cell_ssbo_offset = tools::align_up(cell_start_ssbo_offset + cell_start_ssbo_size, tools::storage_buffer_alignment);
+        sorted_index_ssbo_offset = tools::align_up(particle_cell_ssbo_offset + particle_cell_ssbo_size, tools::storage_buffer_alignment);
+
+        grid_buffer_size = sorted_index_ssbo_offset + sorted_index_ssbo_size;
+
+        for (morton_key_count_ = 1; morton_key_count_ < capacity; morton_key_count_ <<= 1);
+
+        // the scratch copy keeps the SoA offsets of packed_particles_buffer_, the sort keys follow it; between reorders
+        // the compaction after the sinks ranks its gaps in the key array
+        morton_key_ssbo_size = sizeof(glm::uvec2) * morton_key_count_;
+        morton_key_ssbo_offset = tools::align_up(packed_buffer_size, tools::storage_buffer_alignment);
+
+        reorder_buffer_size = morton_key_ssbo_offset + morton_key_ssbo_size;
+
+        // without verlet lists the bindings still need something to point at
+        size_t neighbors_per_particle = settings_.neighbor_search == neighbor_search_mode::verlet_list ? settings_.max_neighbors : 1;
+
+        neighbor_index_ssbo_size = sizeof(uint32_t) * neighbors_per_particle * capacity;
+        neighbor_count_ssbo_size = sizeof(uint32_t) * capacity;
+        list_position_ssbo_size = sizeof(glm::vec2) * capacity;
+
+        neighbor_index_ssbo_offset = 0;
+        neighbor_count_ssbo_offset = tools::align_up(neighbor_index_ssbo_offset + neighbor_index_ssbo_size, tools::storage_buffer_alignment);
+        list_position_ssbo_offset = tools::align_up(neighbor_count_ssbo_offset + neighbor_count_ssbo_size, tools::storage_buffer_alignment);
+
+        neighbor_list_buffer_size = list_position_ssbo_offset + list_position_ssbo_size;
+    }
+
+    void init_window() {
+        glfwInit();
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        window_ = glfwCreateWindow(window_width_, window_height_, "", nullptr, nullptr);
+    }
+
+    void init_vulkan(const std::vector<glm::vec2> initial_positions) {
+        startup_begin_ = std::chrono::high_resolution_clock::now();
+
+        create_instance();
+        setup_debug_messenger();
+
+        if (!settings_.headless)
+            create_surface();
+
+        select_physical_device();
+        create_logical_device();
+        allocator_.create(physical_device_, logical_device_);
+        compute_buffer_layout();
+
+        // headless runs draw into a single offscreen image that stands in for the swapchain images
+        if (settings_.headless) {
+            create_offscreen_target();
+        }
+        else {
+            create_swapchain();
+            get_swapchain_images();
+        }
+        create_swapchain_image_views();
+        create_render_pass();
+        create_swapchain_frame_buffers();
+
+        create_pipeline_cache();
+        startup_phases_.emplace_back("device and swapchain", startup_milliseconds());
+
+        create_graphics_pipeline_layout();
+        create_compute_descriptor_set_layout();
+        create_compute_pipeline_layout();
+        create_reorder_pipeline_layout();
+        create_cull_pipeline_layout();
+        create_splat_resolve_pipeline_layout();
+        start_pipeline_jobs();
+        
+        create_compute_command_pool();
+        
+        create_grid_buffer();
+        create_reorder_buffer();
+        create_neighbor_list_buffers();
+        create_time_step_buffer();
+        create_particle_count_buffer();
+        create_cull_buffer();
+        create_splat_buffer();
+        create_vertex_buffer(initial_positions);
+
+        create_graphics_command_pool();
+        create_graphics_command_buffers();
+        create_semaphores();
+
+        create_descriptor_pool();
+        update_compute_descriptor_sets();
+        update_reorder_descriptor_sets();
+
+        create_compute_command_buffer();
+        create_readback_ring();
+        create_overlap_queries();
+        create_profiler();
+        startup_phases_.emplace_back("buffers, descriptors and command buffers", startup_milliseconds());
+
+        wait_for_required_pipelines();
+        startup_phases_.emplace_back("pipelines of the configured simulation", startup_milliseconds());
+
+        std::cout << "vulkan startup: " << startup_milliseconds() << " ms, " << (pipeline_cache_warm_ ? "warm" : "cold") << " pipeline cache" << std::endl;
+        print_startup_timeline();
+    }
+
+    void destroy_window() {
+        if (settings_.headless) return;
+
+        glfwDestroyWindow(window_);
+        glfwTerminate();
+    }
+
+    void destroy_vulkan() {
+        // a background variant that failed to compile is of no interest any more, and its exception must not escape here
+        join_pipeline_jobs();
+        logical_device_.waitIdle();
+ 
+        logical_device_.destroyCommandPool(compute_command_pool_);
+        
+        logical_device_.destroyDescriptorSetLayout(compute_descriptor_set_layout_);
+        
+        logical_device_.destroyPipelineLayout(compute_pipeline_layout_);
+        logical_device_.destroyPipelineLayout(reorder_pipeline_layout_);
+        logical_device_.destroyPipelineLayout(cull_pipeline_layout_);
+        logical_device_.destroyPipelineLayout(splat_resolve_pipeline_layout_);
+
+        logical_device_.destroyPipeline(density_pipeline_);
+        logical_device_.destroyPipeline(force_pipeline_);
+        logical_device_.destroyPipeline(position_pipeline_);
+
+        logical_device_.destroyPipeline(grid_count_pipeline_);
+        logical_device_.destroyPipeline(grid_scan_pipeline_);
+        logical_device_.destroyPipeline(grid_scatter_pipeline_);
+        logical_device_.destroyPipeline(density_grid_pipeline_);
+        logical_device_.destroyPipeline(force_grid_pipeline_);
+
+        logical_device_.destroyPipeline(hash_count_pipeline_);
+        logical_device_.destroyPipeline(density_hash_pipeline_);
+        logical_device_.destroyPipeline(force_hash_pipeline_);
+
+        logical_device_.destroyPipeline(morton_keys_pipeline_);
+        logical_device_.destroyPipeline(bitonic_sort_pipeline_);
+        logical_device_.destroyPipeline(reorder_pipeline_);
+
+        logical_device_.destroyPipeline(neighbor_list_displacement_pipeline_);
+        logical_device_.destroyPipeline(neighbor_list_decide_pipeline_);
+        logical_device_.destroyPipeline(neighbor_list_build_pipeline_);
+        logical_device_.destroyPipeline(density_list_pipeline_);
+        logical_device_.destroyPipeline(force_list_pipeline_);
+        logical_device_.destroyPipeline(time_step_reduce_pipeline_);
+        logical_device_.destroyPipeline(time_step_update_pipeline_);
+
+        logical_device_.destroyPipeline(particle_sink_pipeline_);
+        logical_device_.destroyPipeline(compact_scan_pipeline_);
+        logical_device_.destroyPipeline(compact_move_pipeline_);
+        logical_device_.destroyPipeline(particle_emit_pipeline_);
+        logical_device_.destroyPipeline(particle_count_update_pipeline_);
+
+        logical_device_.destroyPipeline(particle_cull_pipeline_);
+        logical_device_.destroyPipeline(particle_splat_pipeline_);
+        logical_device_.destroyPipeline(splat_resolve_pipeline_);
+
+        logical_device_.destroySemaphore(render_finished_semaphore_);
+        logical_device_.destroySemaphore(image_available_semaphore_);
+
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+            logical_device_.destroySemaphore(image_available_semaphores[i]);
+            logical_device_.destroySemaphore(render_finished_semaphores[i]);
+            logical_device_.destroyFence(in_flight_fences[i]);
+        }
+
+        logical_device_.destroyFence(compute_fence_);
+
+        staging_.destroy(allocator_);
+
+        for (auto& slot : readback_slots_) {
+            logical_device_.destroyBuffer(slot.buffer);
+            allocator_.free(slot.memory);
+            logical_device_.destroyFence(slot.fence);
+        }
+
+        logical_device_.destroySemaphore(simulation_timeline_);
+        logical_device_.destroySemaphore(render_timeline_);
+
+        logical_device_.destroyQueryPool(overlap_query_pool_);
+        profiler_.destroy();
+
+        logical_device_.destroyCommandPool(graphics_command_pool_);
+
+        logical_device_.destroyPipeline(graphics_pipeline_);
+
+        for (const auto& handle : shader_modules_) {
+            logical_device_.destroyShaderModule(handle);
+        }
+        
+        logical_device_.destroyPipelineLayout(graphics_pipeline_layout_);
+
+        for (const auto& handle : swapchain_frame_buffers_) {
+            logical_device_.destroyFramebuffer(handle);
+        }
+
+        logical_device_.destroyBuffer(packed_particles_buffer_);
+        allocator_.free(packed_particles_memory_);
+
+        logical_device_.destroyBuffer(grid_buffer_);
+        allocator_.free(grid_memory_);
+
+        logical_device_.destroyBuffer(reorder_buffer_);
+        allocator_.free(reorder_memory_);
+
+        logical_device_.destroyBuffer(neighbor_list_buffer_);
+        allocator_.free(neighbor_list_memory_);
+
+        logical_device_.destroyBuffer(neighbor_list_status_buffer_);
+        allocator_.free(neighbor_list_status_memory_);
+
+        logical_device_.destroyBuffer(time_step_buffer_);
+        allocator_.free(time_step_memory_);
+
+        logical_device_.destroyBuffer(particle_count_buffer_);
+        allocator_.free(particle_count_memory_);
+
+        logical_device_.destroyBuffer(cull_buffer_);
+        allocator_.free(cull_memory_);
+
+        logical_device_.destroyBuffer(splat_buffer_);
+        allocator_.free(splat_memory_);
+
+        logical_device_.destroyDescriptorPool(compute_descriptor_pool_);
+
+        save_pipeline_cache();
+        logical_device_.destroyPipelineCache(global_pipeline_cache_handle);
+
+        logical_device_.destroyRenderPass(renderpass_);
+
+        for (const auto& handle : swapchain_image_views_) {
+            logical_device_.destroyImageView(handle);
+        }
+
+        if (settings_.headless) {
+            logical_device_.destroyImage(offscreen_image_);
+            allocator_.free(offscreen_memory_);
+        }
+        else {
+            logical_device_.destroySwapchainKHR(swapchain_handle);
+            instance_.destroySurfaceKHR(surface_);
+        }
+
+        allocator_.destroy();
+        logical_device_.destroy();
+
+        vk_tools::logging::DestroyDebugUtilsMessengerEXT(instance_, debug_messenger_);
+        instance_.destroy();
+    }
+
+    void create_instance() {
+        std::vector<const char*> extensions;
+
+        // headless runs never touch GLFW, there is no surface to create
+        if (!settings_.headless) {
+            uint32_t glfwExtensionCount = 0;
+            auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
+
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+
+        // batch machines rarely have the SDK layers installed, so only the available ones are requested
+        std::vector<const char*> requested_layers;
+        auto available_layers = vk::enumerateInstanceLayerProperties();
+
+        for (const char* layer : { "VK_LAYER_KHRONOS_validation", "VK_LAYER_LUNARG_monitor" }) {
+            bool available = std::any_of(available_layers.begin(), available_layers.end(), [&](const auto& properties) {
+                return std::string_view(properties.layerName.data()) == layer;
+            });
+
+            if (available)
+                requested_layers.push_back(layer);
+        }
+
+        // 1.2 for core timeline semaphores (timelineSemaphore, vkWaitSemaphores, TimelineSemaphoreSubmitInfo), which pace
+        // the steps against the frames and the staged uploads; it also brings vkGetPhysicalDeviceFeatures2 and 16-bit storage
+        auto application_info = vk::ApplicationInfo{};
+        application_info.apiVersion = VK_API_VERSION_1_2;
+
+        auto createInfo = vk::InstanceCreateInfo{};
+        createInfo.pApplicationInfo = &application_info;
+        createInfo.ppEnabledExtensionNames = extensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.enabledLayerCount = static_cast<uint32_t>(requested_layers.size());
+        createInfo.ppEnabledLayerNames = requested_layers.data();
+
+        VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+        populate_debug_messenger_create_info(debugCreateInfo);
+        createInfo.pNext = reinterpret_cast<VkDebugUtilsMessengerCreateInfoEXT*>(&debugCreateInfo);
+
+        instance_ = vk::createInstance(createInfo);
+    }
+
+    void setup_debug_messenger() {
+        VkDebugUtilsMessengerCreateInfoEXT create_info;
+        populate_debug_messenger_create_info(create_info);
+        vk_tools::logging::CreateDebugUtilsMessengerEXT(instance_, create_info, debug_messenger_);
+    }
+
+    void populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInfoEXT& create_info) {
+        create_info = VkDebugUtilsMessengerCreateInfoEXT{};
+        create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+
+        create_info.messageSeverity =
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        create_info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
+            | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+            VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+
+        create_info.pfnUserCallback = vk_tools::logging::debugCallback;
+    }
+
+    void create_surface() {
+        VkSurfaceKHR c_style_surface;
+
+        if (glfwCreateWindowSurface(instance_, window_, nullptr, &c_style_surface) != VK_SUCCESS)
+            throw std::runtime_error("Failed to abstract glfw surface for Vulkan.");
+
+        surface_ = c_style_surface;
+    }
+
+    void select_physical_device() {
+        physical_device_ = instance_.enumeratePhysicalDevices().front();
+    }
+
+    void create_logical_device() {
+        auto properties = physical_device_.getProperties();
+        auto indices = findQueueFamilies(physical_device_, surface_);
+
+        if (!indices.is_complete())
+            throw std::runtime_error("the device has no queue family for both graphics and compute, or none that can present");
+
+        std::set<int> unique_queue_families = { indices.graphics_family, indices.present_family, indices.compute_family, indices.transfer_family };
+
+        std::vector< vk::DeviceQueueCreateInfo> queue_create_infos;
+
+        // must outlive createDevice, every queue gets the same priority
+        const auto priority = 1.0f;
+
+        for (auto queue_family : unique_queue_families) {
+
+            auto queue_create_info = vk::DeviceQueueCreateInfo{};
+
+            queue_create_info.queueFamilyIndex = queue_family;
+            queue_create_info.queueCount = 1;
+
+            queue_create_info.pQueuePriorities = &priority;
+
+            queue_create_infos.emplace_back(queue_create_info);
+        }
+
+        auto device_create_info = vk::DeviceCreateInfo{};
+        device_create_info.pQueueCreateInfos = queue_create_infos.data();
+        device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
+
+        // no swapchain without a surface
+        device_create_info.enabledExtensionCount = settings_.headless ? 0 : static_cast<uint32_t>(tools::requested_extensions.size());
+        device_create_info.ppEnabledExtensionNames = tools::requested_extensions.data();
+
+        // the compact particle layout needs 16-bit loads and stores in storage buffers, without them it falls back to fp32
+        auto supported_features = physical_device_.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevice16BitStorageFeatures, vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+
+        // the compute and graphics queues hand the particle state back and forth through timeline semaphores
+        if (!supported_features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore)
+            throw std::runtime_error("timeline semaphores are not supported");
+
+        if (settings_.compact_storage && !supported_features.get<vk::PhysicalDevice16BitStorageFeatures>().storageBuffer16BitAccess) {
+            std::cout << "16-bit storage buffers are not supported, using the fp32 particle layout" << std::endl;
+            settings_.compact_storage = false;
+        }
+
+        vk::PhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features{};
+        timeline_semaphore_features.timelineSemaphore = true;
+
+        vk::PhysicalDevice16BitStorageFeatures storage_16bit_features{};
+        storage_16bit_features.storageBuffer16BitAccess = settings_.compact_storage;
+        storage_16bit_features.pNext = &timeline_semaphore_features;
+
+        vk::PhysicalDeviceFeatures2 features{};
+        features.features = physical_device_.getFeatures();
+        features.features.samplerAnisotropy = true;
+        features.pNext = &storage_16bit_features;
+
+        device_create_info.pNext = &features;
+
+        logical_device_ = physical_device_.createDevice(device_create_info);
+        
+        present_queue_ = logical_device_.getQueue(indices.present_family, 0);
+        graphics_queue_ = logical_device_.getQueue(indices.graphics_family, 0);
+        compute_queue_ = logical_device_.getQueue(indices.compute_family, 0);
+        transfer_queue_ = logical_device_.getQueue(indices.transfer_family, 0);
+
+        graphics_queue_family_index_ = indices.graphics_family;
+        compute_queue_family_index_ = indices.compute_family;
+        transfer_queue_family_index_ = indices.transfer_family;
+
+        if (compute_queue_family_index_ != graphics_queue_family_index_)
+            std::cout << "running the simulation on the dedicated compute queue family " << compute_queue_family_index_ << std::endl;
+
+        if (transfer_queue_family_index_ != compute_queue_family_index_)
+            std::cout << "uploading through the dedicated transfer queue family " << transfer_queue_family_index_ << std::endl;
+
+        // the overlap of the compute batches with the frames is measured with timestamps from both queues
+        auto queue_family_properties = physical_device_.getQueueFamilyProperties();
+        timestamp_period_ = properties.limits.timestampPeriod;
+        overlap_measurable_ = properties.limits.timestampComputeAndGraphics
+            && queue_family_properties[graphics_queue_family_index_].timestampValidBits > 0
+            && queue_family_properties[compute_queue_family_index_].timestampValidBits > 0;
+    }
+
+    void create_swapchain() {
+        vk::PresentModeKHR swapchain_present_mode = vk::PresentModeKHR::eImmediate;
+        vk::Extent2D extent = { window_width_, window_height_ };
+
+        auto surface_capabilities = physical_device_.getSurfaceCapabilitiesKHR(surface_);
+
+        if (surface_capabilities.currentExtent.width != UINT32_MAX) {
+            extent = surface_capabilities.currentExtent;
+        }
+
+        auto surface_formats = physical_device_.getSurfaceFormatsKHR(surface_);
+
+        for (const auto& entry : surface_formats) {
+            if ((entry.format == vk::Format::eB8G8R8A8Srgb) && (entry.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)) {
+                surface_format_ = entry;
+                break;
+            }
+        }
+
+        uint32_t image_count = surface_capabilities.minImageCount + 1;
+        
+        vk::SwapchainCreateInfoKHR create_info{};        
+        create_info.surface = surface_;
+        create_info.minImageCount = image_count;
+        create_info.imageFormat = surface_format_.format;
+        create_info.imageColorSpace = surface_format_.colorSpace;
+        create_info.imageExtent = extent;
+        create_info.imageArrayLayers = 1;
+        create_info.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+        create_info.imageSharingMode = vk::SharingMode::eExclusive;
+        create_info.queueFamilyIndexCount = 0;
+        create_info.preTransform = surface_capabilities.currentTransform;
+        create_info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
+        create_info.presentMode = swapchain_present_mode;
+        create_info.clipped = VK_TRUE;
+
+        swapchain_handle = logical_device_.createSwapchainKHR(create_info);
+
+        swapchain_extent_ = extent;
+    }
+
+    void create_offscreen_target() {
+        surface_format_.format = vk::Format::eR8G8B8A8Unorm;
+        swapchain_extent_ = vk::Extent2D{ window_width_, window_height_ };
+
+        vk::ImageCreateInfo image_create_info{};
+        image_create_info.imageType = vk::ImageType::e2D;
+        image_create_info.format = surface_format_.format;
+        image_create_info.extent = vk::Extent3D{ window_width_, window_height_, 1 };
+        image_create_info.mipLevels = 1;
+        image_create_info.arrayLayers = 1;
+        image_create_info.samples = vk::SampleCountFlagBits::e1;
+        image_create_info.tiling = vk::ImageTiling::eOptimal;
+        image_create_info.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+        image_create_info.sharingMode = vk::SharingMode::eExclusive;
+        image_create_info.initialLayout = vk::ImageLayout::eUndefined;
+
+        offscreen_image_ = logical_device_.createImage(image_create_info);
+
+        offscreen_memory_ = allocator_.allocate_image(offscreen_image_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        swapchain_images_ = { offscreen_image_ };
+    }
+
+    void get_swapchain_images() {
+        swapchain_images_ = logical_device_.getSwapchainImagesKHR(swapchain_handle);
+    }
+
+    void create_swapchain_image_views() {
+        swapchain_image_views_.resize(swapchain_images_.size());
+
+        for (int i = 0; i < swapchain_image_views_.size(); ++i) {
+            vk::ImageViewCreateInfo image_view_create_info{};
+
+            image_view_create_info.image = swapchain_images_[i];
+            image_view_create_info.viewType = vk::ImageViewType::e2D;
+            image_view_create_info.format = surface_format_.format;
+            image_view_create_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+            image_view_create_info.subresourceRange.levelCount = 1;
+            image_view_create_info.subresourceRange.layerCount = 1;
+
+            swapchain_image_views_[i] = logical_device_.createImageView(image_view_create_info);
+        }
+    }
+
+    void create_render_pass() {
+        vk::AttachmentDescription attachment_description{};
+
+        attachment_description.format = surface_format_.format;
+        attachment_description.initialLayout = vk::ImageLayout::eUndefined;
+        attachment_description.finalLayout = settings_.headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+        attachment_description.samples = vk::SampleCountFlagBits::e1;
+        attachment_description.loadOp = vk::AttachmentLoadOp::eClear;
+        attachment_description.storeOp = vk::AttachmentStoreOp::eStore;
+        attachment_description.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        attachment_description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        
+        vk::AttachmentReference color_attachment_reference{};
+
+        color_attachment_reference.layout = vk::ImageLayout::eColorAttachmentOptimal;
+        color_attachment_reference.attachment = 0;
+
+
+        vk::SubpassDescription subpass_description{};
+
+        subpass_description.colorAttachmentCount = 1;
+        subpass_description.pColorAttachments = &color_attachment_reference;
+        subpass_description.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+        
+
+        vk::RenderPassCreateInfo render_pass_create_info{};
+        render_pass_create_info.attachmentCount = 1;
+        render_pass_create_info.pAttachments = &attachment_description;
+        render_pass_create_info.subpassCount = 1;
+        render_pass_create_info.pSubpasses = &subpass_description;
+
+        renderpass_ = logical_device_.createRenderPass(render_pass_create_info);
+    }
+
+    void create_swapchain_frame_buffers() {
+        swapchain_frame_buffers_.resize(swapchain_image_views_.size());
+
+        for (size_t i = 0; i < swapchain_image_views_.size(); ++i) {
+            vk::FramebufferCreateInfo framebuffer_create_info{};
+            
+            framebuffer_create_info.renderPass = renderpass_;
+            framebuffer_create_info.height = window_height_;
+            framebuffer_create_info.width = window_width_;
+            framebuffer_create_info.attachmentCount = 1;
+            framebuffer_create_info.pAttachments = &swapchain_image_views_[i];
+            framebuffer_create_info.layers = 1;
+
+            swapchain_frame_buffers_[i] = logical_device_.createFramebuffer(framebuffer_create_info);
+        }
+    }
+
+    void create_descriptor_pool() {
+
+        vk::DescriptorPoolSize descriptor_pool_size{};
+        descriptor_pool_size.descriptorCount = 4 * 21;
+        descriptor_pool_size.type = vk::DescriptorType::eStorageBuffer;
+
+        vk::DescriptorPoolCreateInfo create_info{};
+        create_info.maxSets = 4;
+        create_info.poolSizeCount = 1;
+        create_info.pPoolSizes = &descriptor_pool_size;
+
+        compute_descriptor_pool_ = logical_device_.createDescriptorPool(create_info);
+    }
+    
+    // seeds the cache with the blob of the last run, as long as it was written by this device and driver
+    void create_pipeline_cache() {
+        std::vector<char> cache_data = load_pipeline_cache_data();
+
+        VkPipelineCacheCreateInfo create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            NULL,
+            0,
+            cache_data.size(),
+            cache_data.data()
+        };
+
+        global_pipeline_cache_handle = logical_device_.createPipelineCache(create_info);
+        pipeline_cache_warm_ = !cache_data.empty();
+    }
+
+    std::vector<char> load_pipeline_cache_data() {
+        std::ifstream cache_file(settings_.pipeline_cache_path, std::ios::ate | std::ios::binary);
+        if (!cache_file) return {};
+
+        std::vector<char> cache_data(static_cast<size_t>(cache_file.tellg()));
+        cache_file.seekg(0);
+        cache_file.read(cache_data.data(), cache_data.size());
+
+        // VkPipelineCacheHeaderVersionOne: header size, header version, vendor ID, device ID, pipeline cache UUID
+        struct cache_header {
+            uint32_t header_size;
+            uint32_t header_version;
+            uint32_t vendor_id;
+            uint32_t device_id;
+            uint8_t uuid[VK_UUID_SIZE];
+        } header{};
+
+        if (cache_data.size() < sizeof(header)) {
+            std::cout << "ignoring the truncated pipeline cache " << settings_.pipeline_cache_path << std::endl;
+            return {};
+        }
+
+        std::memcpy(&header, cache_data.data(), sizeof(header));
+
+        auto properties = physical_device_.getProperties();
+
+        bool matches = header.header_size >= sizeof(header)
+            && header.header_version == static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne)
+            && header.vendor_id == properties.vendorID
+            && header.device_id == properties.deviceID
+            && std::memcmp(header.uuid, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+
+        if (!matches) {
+            std::cout << "ignoring the pipeline cache " << settings_.pipeline_cache_path << ", it was written by another device or driver" << std::endl;
+            return {};
+        }
+
+        return cache_data;
+    }
+
+    // written next to the old file and renamed over it, so a crash while saving never leaves a torn cache behind
+    void save_pipeline_cache() {
+        auto cache_data = logical_device_.getPipelineCacheData(global_pipeline_cache_handle);
+        const std::string temporary_path = settings_.pipeline_cache_path + ".tmp";
+
+        {
+            std::ofstream cache_file(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!cache_file) return;
+
+            cache_file.write(reinterpret_cast<const char*>(cache_data.data()), cache_data.size());
+            if (!cache_file) return;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary_path, settings_.pipeline_cache_path, error);
+
+        if (error)
+            std::cout << "could not save the pipeline cache: " << error.message() << std::endl;
+    }
+
+    // concurrent between the distinct families in `families`, exclusive if there is only one; `families` has to outlive
+    // the createBuffer call
+    static void set_sharing_mode(vk::BufferCreateInfo& create_info, std::vector<uint32_t>& families) {
+        std::sort(families.begin(), families.end());
+        families.erase(std::unique(families.begin(), families.end()), families.end());
+
+        if (families.size() > 1) {
+            create_info.sharingMode = vk::SharingMode::eConcurrent;
+            create_info.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+            create_info.pQueueFamilyIndices = families.data();
+        }
+        else {
+            create_info.sharingMode = vk::SharingMode::eExclusive;
+        }
+    }
+
+    void create_vertex_buffer(const std::vector<glm::vec2> &positions) {
+        vk::BufferCreateInfo packed_particles_buffer_create_info{};
+
+        packed_particles_buffer_create_info.size = packed_buffer_size;
+        packed_particles_buffer_create_info.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+        // the graphics queue draws one position slice while the compute queue already integrates into the other one and reads the drawn
+        // one; exclusive ownership would have to be transferred back before that read, serializing the queues again. Uploads
+        // from a transfer family share it the same way.
+        std::vector<uint32_t> sharing_queue_families = { graphics_queue_family_index_, compute_queue_family_index_, transfer_queue_family_index_ };
+        set_sharing_mode(packed_particles_buffer_create_info, sharing_queue_families);
+
+        packed_particles_buffer_ = logical_device_.createBuffer(packed_particles_buffer_create_info);
+
+        packed_particles_memory_ = allocator_.allocate_buffer(packed_particles_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        // large enough that a whole small simulation goes up in one batch, large ones stream through it in chunks
+        staging_.create(logical_device_, allocator_, std::min<vk::DeviceSize>(packed_buffer_size, staging_ring_size), transfer_queue_, transfer_queue_family_index_,
+            compute_queue_, compute_command_pool_);
+
+        if (settings_.restore_path.empty())
+            upload_particles(positions);
+        else
+            restore_checkpoint(settings_.restore_path);
+    }
+
+    void create_grid_buffer() {
+        vk::BufferCreateInfo grid_buffer_create_info{};
+
+        grid_buffer_create_info.size = grid_buffer_size;
+        grid_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+        grid_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        grid_buffer_ = logical_device_.createBuffer(grid_buffer_create_info);
+
+        grid_memory_ = allocator_.allocate_buffer(grid_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+
+    void create_reorder_buffer() {
+        vk::BufferCreateInfo reorder_buffer_create_info{};
+
+        reorder_buffer_create_info.size = reorder_buffer_size;
+        reorder_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+        reorder_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        reorder_buffer_ = logical_device_.createBuffer(reorder_buffer_create_info);
+
+        reorder_memory_ = allocator_.allocate_buffer(reorder_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+
+    void create_neighbor_list_buffers() {
+        vk::BufferCreateInfo neighbor_list_buffer_create_info{};
+
+        neighbor_list_buffer_create_info.size = neighbor_list_buffer_size;
+        neighbor_list_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+        neighbor_list_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        neighbor_list_buffer_ = logical_device_.createBuffer(neighbor_list_buffer_create_info);
+
+        neighbor_list_memory_ = allocator_.allocate_buffer(neighbor_list_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        // host visible, so the rebuild and overflow counters can be read without a copy; it is reset through the staging
+        // ring, which may sit on a transfer family
+        vk::BufferCreateInfo status_buffer_create_info{};
+
+        status_buffer_create_info.size = sizeof(neighbor_list_status);
+        status_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst;
+
+        std::vector<uint32_t> status_queue_families = { compute_queue_family_index_, transfer_queue_family_index_ };
+        set_sharing_mode(status_buffer_create_info, status_queue_families);
+
+        neighbor_list_status_buffer_ = logical_device_.createBuffer(status_buffer_create_info);
+
+        neighbor_list_status_memory_ = allocator_.allocate_buffer(neighbor_list_status_buffer_, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        neighbor_list_status_ = reinterpret_cast<neighbor_list_status*>(neighbor_list_status_memory_.mapped);
+    }
+
+    // host visible like the neighbor list status, the dt statistics are read straight from it
+    void create_time_step_buffer() {
+        vk::BufferCreateInfo time_step_buffer_create_info{};
+
+        time_step_buffer_create_info.size = sizeof(time_step_state);
+        time_step_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+
+        std::vector<uint32_t> sharing_queue_families = { compute_queue_family_index_, transfer_queue_family_index_ };
+        set_sharing_mode(time_step_buffer_create_info, sharing_queue_families);
+
+        time_step_buffer_ = logical_device_.createBuffer(time_step_buffer_create_info);
+
+        time_step_memory_ = allocator_.allocate_buffer(time_step_buffer_, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        time_step_state_ = reinterpret_cast<time_step_state*>(time_step_memory_.mapped);
+    }
+
+    // host visible as well: the live count is read back for the stats and the snapshots, and seeded on upload. The
+    // graphics queue takes its draw arguments from it, so it is shared with the graphics and transfer families like the
+    // particles.
+    void create_particle_count_buffer() {
+        vk::BufferCreateInfo particle_count_buffer_create_info{};
+
+        particle_count_buffer_create_info.size = sizeof(particle_count_state);
+        particle_count_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferSrc
+            | vk::BufferUsageFlagBits::eTransferDst;
+
+        std::vector<uint32_t> sharing_queue_families = { graphics_queue_family_index_, compute_queue_family_index_, transfer_queue_family_index_ };
+        set_sharing_mode(particle_count_buffer_create_info, sharing_queue_families);
+
+        particle_count_buffer_ = logical_device_.createBuffer(particle_count_buffer_create_info);
+
+        particle_count_memory_ = allocator_.allocate_buffer(particle_count_buffer_, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        particle_count_ = reinterpret_cast<particle_count_state*>(particle_count_memory_.mapped);
+    }
+
+    // the index list and draw arguments the cull pass writes every frame, followed by the screen bins it decimates in;
+    // only the graphics queue touches it
+    void create_cull_buffer() {
+        culled_draw_ssbo_size = sizeof(culled_draw_arguments) + sizeof(uint32_t) * settings_.capacity();
+
+        cull_bins_x_ = static_cast<uint32_t>(std::ceil(swapchain_extent_.width / cull_bin_size));
+        cull_bins_y_ = static_cast<uint32_t>(std::ceil(swapchain_extent_.height / cull_bin_size));
+        cull_bins_ssbo_offset = tools::align_up(culled_draw_ssbo_size, tools::storage_buffer_alignment);
+        cull_bins_ssbo_size = sizeof(uint32_t) * cull_bins_x_ * cull_bins_y_;
+
+        vk::BufferCreateInfo cull_buffer_create_info{};
+
+        cull_buffer_create_info.size = cull_bins_ssbo_offset + cull_bins_ssbo_size;
+        cull_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eIndirectBuffer
+            | vk::BufferUsageFlagBits::eTransferDst;
+        cull_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        cull_buffer_ = logical_device_.createBuffer(cull_buffer_create_info);
+
+        cull_memory_ = allocator_.allocate_buffer(cull_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+
+    // a particle count per pixel of the render target for the compute rasterizer; created whichever renderer the run
+    // starts with, since the window can switch between them
+    void create_splat_buffer() {
+        splat_ssbo_size = sizeof(uint32_t) * swapchain_extent_.width * swapchain_extent_.height;
+
+        vk::BufferCreateInfo splat_buffer_create_info{};
+
+        splat_buffer_create_info.size = splat_ssbo_size;
+        splat_buffer_create_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+        splat_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        splat_buffer_ = logical_device_.createBuffer(splat_buffer_create_info);
+
+        splat_memory_ = allocator_.allocate_buffer(splat_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+
+public:
+    // resets the simulation state: positions from the argument, every other field and every free slot zeroed
+    void upload_particles(const std::vector<glm::vec2> &positions) {
+        if (positions.size() > settings_.capacity())
+            throw std::runtime_error(std::to_string(positions.size()) + " particles do not fit a capacity of " + std::to_string(settings_.capacity()));
+
+        staging_.fill(packed_particles_buffer_, 0, packed_buffer_size, 0);
+        staging_.write(packed_particles_buffer_, position_ssbo_offset, positions.data(), sizeof(glm::vec2) * positions.size());
+
+        current_state_ = 0;
+        reset_step_state(initial_time_step_state());
+        reset_particle_count(static_cast<uint32_t>(positions.size()));
+        staging_.flush();
+    }
+
+    // continues from a checkpoint: the payload goes from the mapped file straight into the staging ring, and the step it
+    // was taken at is left in restored_step_
+    void restore_checkpoint(const std::string& path) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        mapped_file file(path);
+        auto header = read_checkpoint_header(file, path);
+
+        if (header.particle_count != settings_.capacity() || header.live_count > header.particle_count)
+            throw std::runtime_error(path + " holds " + std::to_string(header.particle_count) + " particle slots, the simulation was set up for " + std::to_string(settings_.capacity()));
+
+        if (static_cast<bool>(header.flags & checkpoint_compact_layout) != settings_.compact_storage)
+            throw std::runtime_error(path + (settings_.compact_storage ? " holds fp32 fields, the simulation was set up for the compact layout" : " holds compact fields, which this device cannot store"));
+
+        if (header.payload_size != packed_buffer_size)
+            throw std::runtime_error(path + " holds a " + std::to_string(header.payload_size) + " byte particle buffer, this device lays it out in " + std::to_string(packed_buffer_size));
+
+        if (header.parameter_hash != checkpoint_parameter_hash(settings_.params))
+            throw std::runtime_error(path + " was simulated with different parameters");
+
+        staging_.write(packed_particles_buffer_, 0, file.data() + header.header_size, packed_buffer_size);
+
+        auto time_step = initial_time_step_state();
+        time_step.dt = header.dt;
+        time_step.step_count = header.time_step_count;
+        time_step.simulated_time = header.simulated_time;
+
+        current_state_ = header.current_state;
+        reset_step_state(time_step);
+        reset_particle_count(header.live_count);
+        staging_.flush();
+
+        restored_step_ = header.simulation_step;
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        std::cout << "restored step " << restored_step_ << " from " << path << ", " << packed_buffer_size / 1048576.0 << " MB in " << elapsed.count() << " ms ("
+            << packed_buffer_size / (elapsed.count() * 1e6) << " GB/s)" << std::endl;
+    }
+
+    // writes the packed particle buffer as the last completed submission left it to a temporary file, renamed over `path`
+    // once complete; nothing may still be writing the buffer
+    void save_checkpoint(const std::string& path, uint64_t simulation_step) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        checkpoint_header header{};
+        std::memcpy(header.magic, "SPHCKPT", 8);
+        header.version = checkpoint_version;
+        header.header_size = checkpoint_header_size;
+        header.payload_size = packed_buffer_size;
+        header.particle_count = settings_.capacity();
+        header.live_count = particle_count_->alive;
+        header.flags = settings_.compact_storage ? checkpoint_compact_layout : 0;
+        header.parameter_hash = checkpoint_parameter_hash(settings_.params);
+        header.simulation_step = simulation_step;
+        header.current_state = current_state_;
+        header.dt = time_step_state_->dt;
+        header.time_step_count = time_step_state_->step_count;
+        header.simulated_time = time_step_state_->simulated_time;
+
+        std::vector<char> padded_header(checkpoint_header_size, 0);
+        std::memcpy(padded_header.data(), &header, sizeof(header));
+
+        auto temporary_path = path + ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            file.write(padded_header.data(), padded_header.size());
+
+            download_packed([&](const char* mapped_memory) {
+                file.write(mapped_memory, packed_buffer_size);
+            });
+
+            if (!file)
+                throw std::runtime_error("cannot write " + temporary_path);
+        }
+
+        std::filesystem::rename(temporary_path, path);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        std::cout << "    checkpoint: step " << simulation_step << " written to " << path << ", " << packed_buffer_size / 1048576.0 << " MB in " << elapsed.count() << " ms" << std::endl;
+    }
+
+    // position and velocity are double buffered: state 0 lives at the *_ssbo_offset, state 1 at the swap_*_ssbo_offset
+    size_t position_offset(uint32_t state) const {
+        return state ? swap_position_ssbo_offset : position_ssbo_offset;
+    }
+
+    size_t velocity_offset(uint32_t state) const {
+        return state ? swap_velocity_ssbo_offset : velocity_ssbo_offset;
+    }
+
+    // the live particles of the last completed step
+    particle_snapshot download_particles() {
+        size_t particle_count = particle_count_->alive;
+
+        particle_snapshot snapshot{};
+        snapshot.position.resize(particle_count);
+        snapshot.velocity.resize(particle_count);
+        snapshot.force.resize(particle_count);
+        snapshot.density.resize(particle_count);
+        snapshot.pressure.resize(particle_count);
+
+        download_packed([&](const char* mapped_memory) {
+            std::memcpy(snapshot.position.data(), mapped_memory + position_offset(current_state_), sizeof(glm::vec2) * particle_count);
+            std::memcpy(snapshot.force.data(), mapped_memory + force_ssbo_offset, sizeof(glm::vec2) * particle_count);
+
+            if (settings_.compact_storage) {
+                auto velocity = reinterpret_cast<const uint32_t*>(mapped_memory + velocity_offset(current_state_));
+                auto density = reinterpret_cast<const uint16_t*>(mapped_memory + density_ssbo_offset);
+                auto pressure = reinterpret_cast<const uint16_t*>(mapped_memory + pressure_ssbo_offset);
+
+                for (size_t i = 0; i < particle_count; ++i) {
+                    snapshot.velocity[i] = glm::unpackHalf2x16(velocity[i]);
+                    snapshot.density[i] = glm::unpackHalf1x16(density[i]);
+                    snapshot.pressure[i] = glm::unpackHalf1x16(pressure[i]) * settings_.params.stiffness;
+                }
+            }
+            else {
+                std::memcpy(snapshot.velocity.data(), mapped_memory + velocity_offset(current_state_), sizeof(glm::vec2) * particle_count);
+                std::memcpy(snapshot.density.data(), mapped_memory + density_ssbo_offset, sizeof(float) * particle_count);
+                std::memcpy(snapshot.pressure.data(), mapped_memory + pressure_ssbo_offset, sizeof(float) * particle_count);
+            }
+        });
+
+        return snapshot;
+    }
+
+    time_step_state initial_time_step_state() const {
+        time_step_state time_step{};
+        time_step.dt = std::clamp(settings_.params.dt, settings_.dt_min, settings_.dt_max);
+        time_step.dt_min = settings_.dt_min;
+        time_step.dt_max = settings_.dt_max;
+        time_step.cfl_number = settings_.cfl_number;
+        time_step.force_factor = settings_.force_factor;
+
+        return time_step;
+    }
+
+    // neighbor list and time step state for a fresh start from a just uploaded packed buffer. Like the particles they go
+    // through the staging ring, so they land after the steps still in flight instead of under them.
+    void reset_step_state(const time_step_state& time_step) {
+        neighbor_list_status status{};
+        status.force_rebuild = 1;
+        status.skin = settings_.neighbor_list_skin;
+        status.max_neighbors = settings_.max_neighbors;
+
+        staging_.write(neighbor_list_status_buffer_, 0, &status, sizeof(status));
+        staging_.write(time_step_buffer_, 0, &time_step, sizeof(time_step));
+    }
+
+    // `alive` particles at the front of the arrays, the emitters and sinks of the settings, none emitted or removed yet
+    void reset_particle_count(uint32_t alive) {
+        const uint32_t workgroup_size = settings_.params.workgroup_size;
+
+        particle_count_state count{};
+        count.alive = alive;
+        count.capacity = settings_.capacity();
+        count.dispatch[0] = (alive + workgroup_size - 1) / workgroup_size;
+        count.dispatch[1] = 1;
+        count.dispatch[2] = 1;
+        count.state = current_state_;
+
+        for (auto& draw : count.draw) {
+            draw[0] = alive;
+            draw[1] = 1;
+        }
+
+        // rows of particles a diameter apart, like the initial block
+        const float spacing = 2 * settings_.params.radius;
+
+        count.emitter_count = static_cast<uint32_t>(settings_.emitters.size());
+        for (size_t i = 0; i < settings_.emitters.size(); ++i) {
+            count.emitters[i].origin = settings_.emitters[i].origin;
+            count.emitters[i].velocity = settings_.emitters[i].velocity;
+            count.emitters[i].row_size = std::max(static_cast<uint32_t>(settings_.emitters[i].width / spacing), 1u);
+            count.emitters[i].travelled = spacing; // the first row goes out with the first step
+        }
+
+        count.sink_count = static_cast<uint32_t>(settings_.sinks.size());
+        for (size_t i = 0; i < settings_.sinks.size(); ++i) {
+            count.sinks[i].lower = settings_.sinks[i].lower;
+            count.sinks[i].upper = settings_.sinks[i].upper;
+        }
+
+        staging_.write(particle_count_buffer_, 0, &count, sizeof(count));
+    }
+
+    // byte offset of the draw arguments of a ping-pong half in particle_count_buffer_
+    static vk::DeviceSize draw_arguments_offset(uint32_t state) {
+        return offsetof(particle_count_state, draw) + state * sizeof(particle_count_state::draw[0]);
+    }
+
+    // copies the whole packed particle buffer into host visible memory and hands `read` its mapping
+    void download_packed(const std::function<void(const char*)>& read) {
+        vk::BufferCreateInfo readback_buffer_create_info{};
+        readback_buffer_create_info.size = packed_buffer_size;
+        readback_buffer_create_info.usage = vk::BufferUsageFlagBits::eTransferDst;
+        readback_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        auto readback_buffer_handle = logical_device_.createBuffer(readback_buffer_create_info);
+        auto readback_memory = allocator_.allocate_buffer(readback_buffer_handle, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            vk::MemoryPropertyFlagBits::eHostCached);
+
+        submit_one_time_commands([&](vk::CommandBuffer copy_command_buffer_handle) {
+            vk::BufferCopy buffer_copy_region{};
+            buffer_copy_region.dstOffset = 0;
+            buffer_copy_region.srcOffset = 0;
+            buffer_copy_region.size = packed_buffer_size;
+
+            copy_command_buffer_handle.copyBuffer(packed_particles_buffer_, readback_buffer_handle, buffer_copy_region);
+        });
+
+        read(readback_memory.mapped);
+
+        logical_device_.destroyBuffer(readback_buffer_handle);
+        allocator_.free(readback_memory);
+    }
+
+    // copies position, velocity, density and pressure of the last submitted step into a readback slot, behind whatever is
+    // already on the compute queue; the slot's fence signals once the copy can be read from the mapped memory
+    void submit_readback(uint32_t slot_index) {
+        auto& slot = readback_slots_[slot_index];
+        logical_device_.resetFences(slot.fence);
+
+        vk::CommandBufferBeginInfo begin_info{};
+        begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        slot.command_buffer.begin(begin_info);
+
+        vk::MemoryBarrier written{};
+        written.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        written.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+        slot.command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), written, {}, {});
+
+        // the fields back to back in trajectory order, the simulated time and the live count behind them
+        const std::array<vk::BufferCopy, 4> field_regions = {
+            vk::BufferCopy{ position_offset(current_state_), 0, position_ssbo_size },
+            vk::BufferCopy{ velocity_offset(current_state_), position_ssbo_size, velocity_ssbo_size },
+            vk::BufferCopy{ density_ssbo_offset, position_ssbo_size + velocity_ssbo_size, density_ssbo_size },
+            vk::BufferCopy{ pressure_ssbo_offset, position_ssbo_size + velocity_ssbo_size + density_ssbo_size, pressure_ssbo_size }
+        };
+        slot.command_buffer.copyBuffer(packed_particles_buffer_, slot.buffer, field_regions);
+        slot.command_buffer.copyBuffer(time_step_buffer_, slot.buffer, vk::BufferCopy{ offsetof(time_step_state, simulated_time), readback_frame_size, sizeof(float) });
+        slot.command_buffer.copyBuffer(particle_count_buffer_, slot.buffer, vk::BufferCopy{ offsetof(particle_count_state, alive), readback_frame_size + sizeof(float), sizeof(uint32_t) });
+
+        // makes the copy visible to the host, and keeps the steps submitted next from overwriting the state before it was read
+        vk::MemoryBarrier copied{};
+        copied.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        copied.dstAccessMask = vk::AccessFlagBits::eHostRead;
+        slot.command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), copied, {}, {});
+
+        slot.command_buffer.end();
+
+        vk::SubmitInfo submit_info{};
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &slot.command_buffer;
+
+        compute_queue_.submit(submit_info, slot.fence);
+    }
+
+    // called from the trajectory writer thread, which is the only one waiting on these fences
+    void wait_for_readback(uint32_t slot_index) {
+        logical_device_.waitForFences(readback_slots_[slot_index].fence, true, UINT64_MAX);
+    }
+
+    // tightly packed RGBA8 rows of the offscreen image, which the last headless render pass left in transfer source layout
+    std::vector<uint8_t> download_offscreen_image() {
+        const vk::DeviceSize image_size = 4ull * swapchain_extent_.width * swapchain_extent_.height;
+
+        vk::BufferCreateInfo readback_buffer_create_info{};
+        readback_buffer_create_info.size = image_size;
+        readback_buffer_create_info.usage = vk::BufferUsageFlagBits::eTransferDst;
+        readback_buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        auto readback_buffer_handle = logical_device_.createBuffer(readback_buffer_create_info);
+        auto readback_memory = allocator_.allocate_buffer(readback_buffer_handle, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            vk::MemoryPropertyFlagBits::eHostCached);
+
+        // the image belongs to the graphics queue family
+        submit_one_time_commands([&](vk::CommandBuffer copy_command_buffer_handle) {
+            vk::BufferImageCopy image_copy_region{};
+            image_copy_region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            image_copy_region.imageSubresource.layerCount = 1;
+            image_copy_region.imageExtent = vk::Extent3D{ swapchain_extent_.width, swapchain_extent_.height, 1 };
+
+            copy_command_buffer_handle.copyImageToBuffer(offscreen_image_, vk::ImageLayout::eTransferSrcOptimal, readback_buffer_handle, image_copy_region);
+        }, graphics_queue_, graphics_command_pool_);
+
+        auto mapped_memory = reinterpret_cast<const uint8_t*>(readback_memory.mapped);
+        std::vector<uint8_t> pixels(mapped_memory, mapped_memory + image_size);
+
+        logical_device_.destroyBuffer(readback_buffer_handle);
+        allocator_.free(readback_memory);
+
+        return pixels;
+    }
+
+    void submit_compute_and_wait() {
+        vk::SubmitInfo submit_info{};
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &compute_command_buffers_[current_state_];
+
+        compute_queue_.submit(submit_info);
+        compute_queue_.waitIdle();
+
+        current_state_ ^= 1;
+    }
+
+private:
+
+    void create_graphics_pipeline_layout() {
+        vk::PushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
+        push_constant_range.offset = 0;
+        push_constant_range.size = sizeof(view_push_constants);
+
+        vk::PipelineLayoutCreateInfo create_info{};
+        create_info.pPushConstantRanges = &push_constant_range;
+        create_info.pushConstantRangeCount = 1;
+
+        graphics_pipeline_layout_ = logical_device_.createPipelineLayout(create_info);
+    }
+
+    void create_graphics_pipeline() {
+        std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_infos;
+
+        VkShaderModule vertex_shader_module = load_shader_module("particle.vert.spv");
+
+        VkShaderModule fragment_shader_module = load_shader_module("particle.frag.spv");
+
+        VkPipelineShaderStageCreateInfo vertex_shader_stage_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            vertex_shader_module,
+            "main",
+            NULL
+        };
+
+        VkPipelineShaderStageCreateInfo fragment_shader_stage_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            fragment_shader_module,
+            "main",
+            NULL
+        };
+
+        shader_stage_create_infos.push_back(vertex_shader_stage_create_info);
+        shader_stage_create_infos.push_back(fragment_shader_stage_create_info);
+
+        VkVertexInputBindingDescription vertex_input_binding_description
+        {
+            0,
+            sizeof(glm::vec2),
+            VK_VERTEX_INPUT_RATE_VERTEX
+        };
+
+        VkVertexInputAttributeDescription vertex_input_attribute_description
+        {
+            0,
+            0,
+            VK_FORMAT_R32G32_SFLOAT,
+            0
+        };
+
+        VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            &vertex_input_binding_description,
+            1,
+            &vertex_input_attribute_description
+        };
+
+        VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+            VK_FALSE
+        };
+
+        VkViewport viewport
+        {
+            0,
+            0,
+            static_cast<float>(window_width_),
+            static_cast<float>(window_height_),
+            0,
+            1
+        };
+
+        VkRect2D scissor
+        {
+            { 0, 0 },
+            { window_width_, window_height_ }
+        };
+
+        VkPipelineViewportStateCreateInfo viewport_state_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            &viewport,
+            1,
+            &scissor
+        };
+
+        VkPipelineRasterizationStateCreateInfo rasterization_state_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_FALSE,
+            VK_FALSE,
+            VK_POLYGON_MODE_FILL,
+            VK_CULL_MODE_NONE,
+            VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            VK_FALSE,
+            0,
+            0,
+            0,
+            1
+        };
+
+        VkPipelineMultisampleStateCreateInfo multisample_state_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_FALSE,
+            0,
+            NULL,
+            VK_FALSE,
+            VK_FALSE
+        };
+
+        VkPipelineColorBlendAttachmentState color_blend_attachment
+        {
+            VK_FALSE,
+            VK_BLEND_FACTOR_ONE,
+            VK_BLEND_FACTOR_ZERO,
+            VK_BLEND_OP_ADD,
+            VK_BLEND_FACTOR_ONE,
+            VK_BLEND_FACTOR_ZERO,
+            VK_BLEND_OP_ADD,
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+        };
+
+        VkPipelineColorBlendStateCreateInfo color_blend_state_create_info
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_FALSE,
+            VK_LOGIC_OP_COPY,
+            1,
+            &color_blend_attachment,
+            {0, 0, 0, 0}
+        };
+
+        VkGraphicsPipelineCreateInfo graphics_pipeline_create_info
+        {
+            VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            NULL,
+            0,
+            static_cast<uint32_t>(shader_stage_create_infos.size()),
+            shader_stage_create_infos.data(),
+            &vertex_input_state_create_info,
+            &input_assembly_state_create_info,
+            NULL,
+            &viewport_state_create_info,
+            &rasterization_state_create_info,
+            &multisample_state_create_info,
+            NULL,
+            &color_blend_state_create_info,
+            NULL,
+            graphics_pipeline_layout_,
+            renderpass_,
+            0,
+            VK_NULL_HANDLE,
+            -1
+        };
+
+        graphics_pipeline_ = logical_device_.createGraphicsPipeline(global_pipeline_cache_handle, graphics_pipeline_create_info).value;
+    }
+
+    void create_graphics_pipeline1() {
+        std::vector<vk::PipelineShaderStageCreateInfo> shader_stage_create_infos;
+
+        auto vertex_shader_module = load_shader_module("particle.vert.spv");
+        auto fragment_shader_module = load_shader_module("particle.frag.spv");
+
+        vk::PipelineShaderStageCreateInfo vertex_shader_stage_create_info{};
+        vertex_shader_stage_create_info.stage = vk::ShaderStageFlagBits::eVertex;
+        vertex_shader_stage_create_info.module = vertex_shader_module;
+        vertex_shader_stage_create_info.pName = "main";
+
+        vk::PipelineShaderStageCreateInfo fragment_shader_stage_create_info{};
+        fragment_shader_stage_create_info.stage = vk::ShaderStageFlagBits::eFragment;
+        fragment_shader_stage_create_info.module = fragment_shader_module;
+        fragment_shader_stage_create_info.pName = "main";
+
+        shader_stage_create_infos.push_back(vertex_shader_stage_create_info);
+        shader_stage_create_infos.push_back(fragment_shader_stage_create_info);
+
+        vk::VertexInputBindingDescription vertex_input_binding_description{};
+        vertex_input_binding_description.binding = 0;
+        vertex_input_binding_description.inputRate = vk::VertexInputRate::eVertex;
+        vertex_input_binding_description.stride = sizeof(glm::vec2);
+
+        vk::VertexInputAttributeDescription vertex_input_attribute_description{};
+        vertex_input_attribute_description.format = vk::Format::eR32G32Sfloat;
+        vertex_input_attribute_description.location = 0;
+        vertex_input_attribute_description.binding = 0;
+        vertex_input_attribute_description.offset = 0;
+
+        vk::PipelineVertexInputStateCreateInfo vertex_input_state_create_info{};
+        vertex_input_state_create_info.vertexAttributeDescriptionCount = 1;
+        vertex_input_state_create_info.pVertexAttributeDescriptions = &vertex_input_attribute_description;
+        vertex_input_state_create_info.vertexBindingDescriptionCount = 1;
+        vertex_input_state_create_info.pVertexBindingDescriptions = &vertex_input_binding_description;
+        
+        vk::PipelineInputAssemblyStateCreateInfo input_assembly_state_create_info{};
+        input_assembly_state_create_info.topology = vk::PrimitiveTopology::ePointList;
+        input_assembly_state_create_info.primitiveRestartEnable = false;
+
+        vk::Viewport viewport{};
+        viewport.height = static_cast<float>(window_height_);
+        viewport.width = static_cast<float>(window_width_);
+        viewport.x = 0;
+        viewport.y = 0;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        vk::Rect2D scissor{};
+        scissor.offset = vk::Offset2D{ 0, 0 };
+        scissor.extent = vk::Extent2D{ window_width_, window_height_ };
+
+        vk::PipelineViewportStateCreateInfo viewport_state_create_info{};
+        viewport_state_create_info.scissorCount = 1;
+        viewport_state_create_info.pScissors = &scissor;
+        viewport_state_create_info.viewportCount = 1;
+        viewport_state_create_info.pViewports = &viewport;
+
+        vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info{};
+        rasterization_state_create_info.cullMode = vk::CullModeFlagBits::eNone;
+        rasterization_state_create_info.frontFace = vk::FrontFace::eCounterClockwise;
+        rasterization_state_create_info.polygonMode = vk::PolygonMode::eFill;
+        rasterization_state_create_info.lineWidth = 1;
+
+        vk::PipelineMultisampleStateCreateInfo multisample_state_create_info{};
+        multisample_state_create_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+        vk::PipelineColorBlendAttachmentState color_blend_attachment{};
+        color_blend_attachment.blendEnable = false;
+        color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+        color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eZero;
+        color_blend_attachment.colorBlendOp = vk::BlendOp::eAdd;
+        color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
+        color_blend_attachment.alphaBlendOp = vk::BlendOp::eAdd;
+        color_blend_attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+        vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info{};
+        color_blend_state_create_info.logicOp = vk::LogicOp::eCopy;
+        color_blend_state_create_info.attachmentCount = 1;
+        color_blend_state_create_info.pAttachments = &color_blend_attachment;
+        color_blend_state_create_info.blendConstants[0] = 0.0f;
+        color_blend_state_create_info.blendConstants[1] = 0.0f;
+        color_blend_state_create_info.blendConstants[2] = 0.0f;
+        color_blend_state_create_info.blendConstants[3] = 0.0f;
+
+        vk::GraphicsPipelineCreateInfo graphics_pipeline_create_info{};
+
+        graphics_pipeline_create_info.stageCount = static_cast<uint32_t>(shader_stage_create_infos.size());
+        graphics_pipeline_create_info.pStages = shader_stage_create_infos.data();
+        graphics_pipeline_create_info.pVertexInputState = &vertex_input_state_create_info;
+        graphics_pipeline_create_info.pInputAssemblyState = &input_assembly_state_create_info;
+        graphics_pipeline_create_info.pViewportState = &viewport_state_create_info;
+        graphics_pipeline_create_info.pMultisampleState = &multisample_state_create_info;
+        graphics_pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
+        graphics_pipeline_create_info.renderPass = renderpass_;
+        graphics_pipeline_create_info.basePipelineIndex = -1;
+        graphics_pipeline_create_info.layout = graphics_pipeline_layout_;
+
+        graphics_pipeline_ = logical_device_.createGraphicsPipeline(global_pipeline_cache_handle, graphics_pipeline_create_info).value;
+    }
+
+    // one fullscreen triangle that colours every pixel the splat pass counted particles in
+    void create_splat_resolve_pipeline() {
+        vk::PipelineShaderStageCreateInfo shader_stage_create_infos[2]{};
+
+        shader_stage_create_infos[0].stage = vk::ShaderStageFlagBits::eVertex;
+        shader_stage_create_infos[0].module = load_shader_module("splat_resolve.vert.spv");
+        shader_stage_create_infos[0].pName = "main";
+
+        shader_stage_create_infos[1].stage = vk::ShaderStageFlagBits::eFragment;
+        shader_stage_create_infos[1].module = load_shader_module("splat_resolve.frag.spv");
+        shader_stage_create_infos[1].pName = "main";
+
+        vk::PipelineVertexInputStateCreateInfo vertex_input_state_create_info{};
+
+        vk::PipelineInputAssemblyStateCreateInfo input_assembly_state_create_info{};
+        input_assembly_state_create_info.topology = vk::PrimitiveTopology::eTriangleList;
+
+        vk::Viewport viewport{};
+        viewport.width = static_cast<float>(window_width_);
+        viewport.height = static_cast<float>(window_height_);
+        viewport.maxDepth = 1.0f;
+
+        vk::Rect2D scissor{};
+        scissor.extent = vk::Extent2D{ window_width_, window_height_ };
+
+        vk::PipelineViewportStateCreateInfo viewport_state_create_info{};
+        viewport_state_create_info.viewportCount = 1;
+        viewport_state_create_info.pViewports = &viewport;
+        viewport_state_create_info.scissorCount = 1;
+        viewport_state_create_info.pScissors = &scissor;
+
+        vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info{};
+        rasterization_state_create_info.cullMode = vk::CullModeFlagBits::eNone;
+        rasterization_state_create_info.frontFace = vk::FrontFace::eCounterClockwise;
+        rasterization_state_create_info.polygonMode = vk::PolygonMode::eFill;
+        rasterization_state_create_info.lineWidth = 1;
+
+        vk::PipelineMultisampleStateCreateInfo multisample_state_create_info{};
+        multisample_state_create_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+        vk::PipelineColorBlendAttachmentState color_blend_attachment{};
+        color_blend_attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+        vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info{};
+        color_blend_state_create_info.attachmentCount = 1;
+        color_blend_state_create_info.pAttachments = &color_blend_attachment;
+
+        vk::GraphicsPipelineCreateInfo graphics_pipeline_create_info{};
+        graphics_pipeline_create_info.stageCount = 2;
+        graphics_pipeline_create_info.pStages = shader_stage_create_infos;
+        graphics_pipeline_create_info.pVertexInputState = &vertex_input_state_create_info;
+        graphics_pipeline_create_info.pInputAssemblyState = &input_assembly_state_create_info;
+        graphics_pipeline_create_info.pViewportState = &viewport_state_create_info;
+        graphics_pipeline_create_info.pRasterizationState = &rasterization_state_create_info;
+        graphics_pipeline_create_info.pMultisampleState = &multisample_state_create_info;
+        graphics_pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
+        graphics_pipeline_create_info.layout = splat_resolve_pipeline_layout_;
+        graphics_pipeline_create_info.renderPass = renderpass_;
+        graphics_pipeline_create_info.basePipelineIndex = -1;
+
+        splat_resolve_pipeline_ = logical_device_.createGraphicsPipeline(global_pipeline_cache_handle, graphics_pipeline_create_info).value;
+    }
+    
+    void create_graphics_command_pool() {
+        vk::CommandPoolCreateInfo create_info{};
+        create_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        create_info.queueFamilyIndex = graphics_queue_family_index_;
+
+        graphics_command_pool_ = logical_device_.createCommandPool(create_info);
+    }
+
+    void create_graphics_command_buffers() {
+        graphics_command_buffers_.resize(swapchain_frame_buffers_.size());
+
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = graphics_command_pool_;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        alloc_info.commandBufferCount = static_cast<uint32_t>(graphics_command_buffers_.size());
+ 
+        graphics_command_buffers_ = logical_device_.allocateCommandBuffers(alloc_info);
+    }
+
+    void create_semaphores() {
+        vk::SemaphoreCreateInfo semaphore_info{};
+
+        vk::FenceCreateInfo fence_info{};
+        fence_info.flags = vk::FenceCreateFlagBits::eSignaled;
+
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+            image_available_semaphores.emplace_back(logical_device_.createSemaphore(semaphore_info));
+            render_finished_semaphores.emplace_back(logical_device_.createSemaphore(semaphore_info));
+            in_flight_fences.emplace_back(logical_device_.createFence(fence_info));
+        }
+
+        compute_fence_ = logical_device_.createFence(fence_info);
+
+        vk::SemaphoreTypeCreateInfo timeline_info{};
+        timeline_info.semaphoreType = vk::SemaphoreType::eTimeline;
+        timeline_info.initialValue = 0;
+
+        vk::SemaphoreCreateInfo timeline_semaphore_info{};
+        timeline_semaphore_info.pNext = &timeline_info;
+
+        simulation_timeline_ = logical_device_.createSemaphore(timeline_semaphore_info);
+        render_timeline_ = logical_device_.createSemaphore(timeline_semaphore_info);
+
+        vk::SemaphoreCreateInfo semaphore_create_info{};
+        image_available_semaphore_ = logical_device_.createSemaphore(semaphore_create_info);
+        render_finished_semaphore_ = logical_device_.createSemaphore(semaphore_create_info);
+    }
+
+    void create_compute_descriptor_set_layout() {
+        vk::DescriptorSetLayoutBinding position = {};
+        position.binding = 0;
+        position.descriptorCount = 1;
+        position.descriptorType = vk::DescriptorType::eStorageBuffer;
+        position.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding velocity = {};
+        velocity.binding = 1;
+        velocity.descriptorCount = 1;
+        velocity.descriptorType = vk::DescriptorType::eStorageBuffer;
+        velocity.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding force = {};
+        force.binding = 2;
+        force.descriptorCount = 1;
+        force.descriptorType = vk::DescriptorType::eStorageBuffer;
+        force.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding density = {};
+        density.binding = 3;
+        density.descriptorCount = 1;
+        density.descriptorType = vk::DescriptorType::eStorageBuffer;
+        density.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding pressure = {};
+        pressure.binding = 4;
+        pressure.descriptorCount = 1;
+        pressure.descriptorType = vk::DescriptorType::eStorageBuffer;
+        pressure.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding cell_count = {};
+        cell_count.binding = 5;
+        cell_count.descriptorCount = 1;
+        cell_count.descriptorType = vk::DescriptorType::eStorageBuffer;
+        cell_count.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding cell_start = {};
+        cell_start.binding = 6;
+        cell_start.descriptorCount = 1;
+        cell_start.descriptorType = vk::DescriptorType::eStorageBuffer;
+        cell_start.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding particle_cell = {};
+        particle_cell.binding = 7;
+        particle_cell.descriptorCount = 1;
+        particle_cell.descriptorType = vk::DescriptorType::eStorageBuffer;
+        particle_cell.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding sorted_index = {};
+        sorted_index.binding = 8;
+        sorted_index.descriptorCount = 1;
+        sorted_index.descriptorType = vk::DescriptorType::eStorageBuffer;
+        sorted_index.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding morton_key = {};
+        morton_key.binding = 9;
+        morton_key.descriptorCount = 1;
+        morton_key.descriptorType = vk::DescriptorType::eStorageBuffer;
+        morton_key.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding neighbor_index = {};
+        neighbor_index.binding = 10;
+        neighbor_index.descriptorCount = 1;
+        neighbor_index.descriptorType = vk::DescriptorType::eStorageBuffer;
+        neighbor_index.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding neighbor_count = {};
+        neighbor_count.binding = 11;
+        neighbor_count.descriptorCount = 1;
+        neighbor_count.descriptorType = vk::DescriptorType::eStorageBuffer;
+        neighbor_count.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding list_position = {};
+        list_position.binding = 12;
+        list_position.descriptorCount = 1;
+        list_position.descriptorType = vk::DescriptorType::eStorageBuffer;
+        list_position.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding list_status = {};
+        list_status.binding = 13;
+        list_status.descriptorCount = 1;
+        list_status.descriptorType = vk::DescriptorType::eStorageBuffer;
+        list_status.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding time_step = {};
+        time_step.binding = 14;
+        time_step.descriptorCount = 1;
+        time_step.descriptorType = vk::DescriptorType::eStorageBuffer;
+        time_step.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding next_position = {};
+        next_position.binding = 15;
+        next_position.descriptorCount = 1;
+        next_position.descriptorType = vk::DescriptorType::eStorageBuffer;
+        next_position.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding next_velocity = {};
+        next_velocity.binding = 16;
+        next_velocity.descriptorCount = 1;
+        next_velocity.descriptorType = vk::DescriptorType::eStorageBuffer;
+        next_velocity.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding particle_count = {};
+        particle_count.binding = 17;
+        particle_count.descriptorCount = 1;
+        particle_count.descriptorType = vk::DescriptorType::eStorageBuffer;
+        particle_count.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding culled_draw = {};
+        culled_draw.binding = 18;
+        culled_draw.descriptorCount = 1;
+        culled_draw.descriptorType = vk::DescriptorType::eStorageBuffer;
+        culled_draw.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding cull_bins = {};
+        cull_bins.binding = 19;
+        cull_bins.descriptorCount = 1;
+        cull_bins.descriptorType = vk::DescriptorType::eStorageBuffer;
+        cull_bins.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        // also read by the fullscreen pass that resolves it
+        vk::DescriptorSetLayoutBinding splat_counts = {};
+        splat_counts.binding = 20;
+        splat_counts.descriptorCount = 1;
+        splat_counts.descriptorType = vk::DescriptorType::eStorageBuffer;
+        splat_counts.stageFlags = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment;
+
+        vk::DescriptorSetLayoutBinding bindings[] = {
+            position, velocity, force, density, pressure,
+            cell_count, cell_start, particle_cell, sorted_index,
+            morton_key,
+            neighbor_index, neighbor_count, list_position, list_status,
+            time_step,
+            next_position, next_velocity,
+            particle_count,
+            culled_draw, cull_bins,
+            splat_counts
+        };
+
+        vk::DescriptorSetLayoutCreateInfo create_info{};
+        create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+        create_info.pBindings = bindings;
+
+        compute_descriptor_set_layout_ = logical_device_.createDescriptorSetLayout(create_info);
+    }
+
+    // fills every binding of compute_descriptor_set_layout_; the particle arrays come from `particles`, laid out like packed_particles_buffer_,
+    // the step reads position and velocity of `state` (bindings 0, 1) and writes the other state (15, 16)
+    void write_compute_descriptor_set(vk::DescriptorSet descriptor_set, vk::Buffer particles, uint32_t state) {
+        vk::DescriptorBufferInfo buffer_infos[] = {
+            { particles, position_offset(state), position_ssbo_size },
+            { particles, velocity_offset(state), velocity_ssbo_size },
+            { particles, force_ssbo_offset, force_ssbo_size },
+            { particles, density_ssbo_offset, density_ssbo_size },
+            { particles, pressure_ssbo_offset, pressure_ssbo_size },
+            { grid_buffer_, cell_count_ssbo_offset, cell_count_ssbo_size },
+            { grid_buffer_, cell_start_ssbo_offset, cell_start_ssbo_size },
+            { grid_buffer_, particle_cell_ssbo_offset, particle_cell_ssbo_size },
+            { grid_buffer_, sorted_index_ssbo_offset, sorted_index_ssbo_size },
+            { reorder_buffer_, morton_key_ssbo_offset, morton_key_ssbo_size },
+            { neighbor_list_buffer_, neighbor_index_ssbo_offset, neighbor_index_ssbo_size },
+            { neighbor_list_buffer_, neighbor_count_ssbo_offset, neighbor_count_ssbo_size },
+            { neighbor_list_buffer_, list_position_ssbo_offset, list_position_ssbo_size },
+            { neighbor_list_status_buffer_, 0, sizeof(neighbor_list_status) },
+            { time_step_buffer_, 0, sizeof(time_step_state) },
+            { particles, position_offset(state ^ 1), position_ssbo_size },
+            { particles, velocity_offset(state ^ 1), velocity_ssbo_size },
+            { particle_count_buffer_, 0, sizeof(particle_count_state) },
+            { cull_buffer_, 0, culled_draw_ssbo_size },
+            { cull_buffer_, cull_bins_ssbo_offset, cull_bins_ssbo_size },
+            { splat_buffer_, 0, splat_ssbo_size }
+        };
+
+        std::vector<vk::WriteDescriptorSet> write_descriptor_sets;
+
+        for (uint32_t binding = 0; binding < std::size(buffer_infos); ++binding) {
+            vk::WriteDescriptorSet write{};
+            write.dstSet = descriptor_set;
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            write.pBufferInfo = &buffer_infos[binding];
+
+            write_descriptor_sets.push_back(write);
+        }
+
+        logical_device_.updateDescriptorSets(write_descriptor_sets, {});
+    }
+
+    // one set per ping-pong state, indexed by the state the step reads
+    void update_compute_descriptor_sets() {
+        vk::DescriptorSetLayout set_layouts[] = { compute_descriptor_set_layout_, compute_descriptor_set_layout_ };
+
+        vk::DescriptorSetAllocateInfo alloc_info{};
+        alloc_info.descriptorSetCount = 2;
+        alloc_info.pSetLayouts = set_layouts;
+        alloc_info.descriptorPool = compute_descriptor_pool_;
+
+        auto descriptor_sets = logical_device_.allocateDescriptorSets(alloc_info);
+
+        for (uint32_t state = 0; state < 2; ++state) {
+            compute_descriptor_sets_[state] = descriptor_sets[state];
+            write_compute_descriptor_set(compute_descriptor_sets_[state], packed_particles_buffer_, state);
+        }
+    }
+
+    // same layout as compute_descriptor_sets_, but the particle bindings view the scratch copy in reorder_buffer_
+    void update_reorder_descriptor_sets() {
+        vk::DescriptorSetLayout set_layouts[] = { compute_descriptor_set_layout_, compute_descriptor_set_layout_ };
+
+        vk::DescriptorSetAllocateInfo alloc_info{};
+        alloc_info.descriptorSetCount = 2;
+        alloc_info.pSetLayouts = set_layouts;
+        alloc_info.descriptorPool = compute_descriptor_pool_;
+
+        auto descriptor_sets = logical_device_.allocateDescriptorSets(alloc_info);
+
+        for (uint32_t state = 0; state < 2; ++state) {
+            reorder_source_descriptor_sets_[state] = descriptor_sets[state];
+            write_compute_descriptor_set(reorder_source_descriptor_sets_[state], reorder_buffer_, state);
+        }
+    }
+
+    void update_compute_descriptor_sets1() {
+        vk::DescriptorSetAllocateInfo alloc_info{};
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &compute_descriptor_set_layout_;
+        alloc_info.descriptorPool = compute_descriptor_pool_;
+
+        compute_descriptor_sets_[0] = logical_device_.allocateDescriptorSets(alloc_info).front();
+
+        vk::DescriptorBufferInfo position{};
+        position.buffer = packed_particles_buffer_;
+        position.offset = position_ssbo_offset;
+        position.range = position_ssbo_size;
+
+        vk::DescriptorBufferInfo velocity{};
+        velocity.buffer = packed_particles_buffer_;
+        velocity.offset = velocity_ssbo_offset;
+        velocity.range = velocity_ssbo_size;
+
+        vk::DescriptorBufferInfo force{};
+        force.buffer = packed_particles_buffer_;
+        force.offset = force_ssbo_offset;
+        force.range = force_ssbo_size;
+
+        vk::DescriptorBufferInfo density{};
+        density.buffer = packed_particles_buffer_;
+        density.offset = density_ssbo_offset;
+        density.range = density_ssbo_size;
+
+        vk::DescriptorBufferInfo pressure{};
+        pressure.buffer = packed_particles_buffer_;
+        pressure.offset = pressure_ssbo_offset;
+        pressure.range = pressure_ssbo_size;
+
+        vk::WriteDescriptorSet write_position{};
+        write_position.descriptorCount = 1;
+        write_position.dstBinding = 0;
+        write_position.dstSet = compute_descriptor_sets_[0];
+        write_position.pBufferInfo = &position;
+
+        vk::WriteDescriptorSet write_velocity{};
+        write_velocity.descriptorCount = 1;
+        write_velocity.dstBinding = 1;
+        write_velocity.dstSet = compute_descriptor_sets_[0];
+        write_velocity.pBufferInfo = &velocity;
+
+        vk::WriteDescriptorSet write_force{};
+        write_force.descriptorCount = 1;
+        write_force.dstBinding = 2;
+        write_force.dstSet = compute_descriptor_sets_[0];
+        write_force.pBufferInfo = &force;
+
+        vk::WriteDescriptorSet write_density{};
+        write_density.descriptorCount = 1;
+        write_density.dstBinding = 3;
+        write_density.dstSet = compute_descriptor_sets_[0];
+        write_density.pBufferInfo = &density;
+
+        vk::WriteDescriptorSet write_pressure{};
+        write_pressure.descriptorCount = 1;
+        write_pressure.dstBinding = 4;
+        write_pressure.dstSet = compute_descriptor_sets_[0];
+        write_pressure.pBufferInfo = &pressure;
+
+        vk::WriteDescriptorSet write_descriptor_sets[] = { write_position, write_velocity, write_force, write_density, write_pressure };
+
+        logical_device_.updateDescriptorSets(write_descriptor_sets, {});
+    }
+    
+    // the push constants carry the per-step tunables, see sim_params
+    void create_compute_pipeline_layout() {
+        vk::PushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+        push_constant_range.offset = 0;
+        push_constant_range.size = sizeof(simulation_push_constants);
+
+        vk::PipelineLayoutCreateInfo create_info{};
+        create_info.pSetLayouts = &compute_descriptor_set_layout_;
+        create_info.setLayoutCount = 1;
+        create_info.pPushConstantRanges = &push_constant_range;
+        create_info.pushConstantRangeCount = 1;
+        
+        compute_pipeline_layout_ = logical_device_.createPipelineLayout(create_info);
+    }
+
+    // set 0: live particles, set 1: scratch copy to permute from; the push constants drive the bitonic stages and carry
+    // the bounding box the Morton keys are quantized in
+    void create_reorder_pipeline_layout() {
+        vk::DescriptorSetLayout set_layouts[] = { compute_descriptor_set_layout_, compute_descriptor_set_layout_ };
+
+        vk::PushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+        push_constant_range.offset = 0;
+        push_constant_range.size = 2 * sizeof(uint32_t) + sizeof(glm::vec2);
+
+        vk::PipelineLayoutCreateInfo create_info{};
+        create_info.pSetLayouts = set_layouts;
+        create_info.setLayoutCount = 2;
+        create_info.pPushConstantRanges = &push_constant_range;
+        create_info.pushConstantRangeCount = 1;
+
+        reorder_pipeline_layout_ = logical_device_.createPipelineLayout(create_info);
+    }
+
+    // set 0 for the particles of the drawn half, the view in the push constants
+    void create_cull_pipeline_layout() {
+        vk::PushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+        push_constant_range.offset = 0;
+        push_constant_range.size = sizeof(view_push_constants);
+
+        vk::PipelineLayoutCreateInfo create_info{};
+        create_info.pSetLayouts = &compute_descriptor_set_layout_;
+        create_info.setLayoutCount = 1;
+        create_info.pPushConstantRanges = &push_constant_range;
+        create_info.pushConstantRangeCount = 1;
+
+        cull_pipeline_layout_ = logical_device_.createPipelineLayout(create_info);
+    }
+
+    // the compute set for the splat counts, the extent from the view push constants
+    void create_splat_resolve_pipeline_layout() {
+        vk::PushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = vk::ShaderStageFlagBits::eFragment;
+        push_constant_range.offset = 0;
+        push_constant_range.size = sizeof(view_push_constants);
+
+        vk::PipelineLayoutCreateInfo create_info{};
+        create_info.pSetLayouts = &compute_descriptor_set_layout_;
+        create_info.setLayoutCount = 1;
+        create_info.pPushConstantRanges = &push_constant_range;
+        create_info.pushConstantRangeCount = 1;
+
+        splat_resolve_pipeline_layout_ = logical_device_.createPipelineLayout(create_info);
+    }
+
+    // structural parameters every compute shader is specialized with: 0 workgroup size, 1 kernel radius h, 2 grid resolution, 3 adaptive time step
+    struct specialization_data {
+        uint32_t workgroup_size;
+        float h;
+        int32_t grid_resolution;
+        vk::Bool32 adaptive_time_step;
+    };
+
+    // shaders reading velocity, density or pressure are also built with -DCOMPACT_STORAGE for the fp16 layout
+    std::string particle_shader_file(const std::string& name) const {
+        return name + (settings_.compact_storage ? ".compact.comp.spv" : ".comp.spv");
+    }
+
+    const vk::SpecializationInfo* compute_specialization_info() {
+        specialization_data_.workgroup_size = settings_.params.workgroup_size;
+        specialization_data_.h = settings_.params.kernel_radius();
+        specialization_data_.grid_resolution = static_cast<int32_t>(settings_.params.grid_resolution());
+        specialization_data_.adaptive_time_step = settings_.adaptive_time_step;
+
+        specialization_map_entries_[0] = vk::SpecializationMapEntry(0, offsetof(specialization_data, workgroup_size), sizeof(uint32_t));
+        specialization_map_entries_[1] = vk::SpecializationMapEntry(1, offsetof(specialization_data, h), sizeof(float));
+        specialization_map_entries_[2] = vk::SpecializationMapEntry(2, offsetof(specialization_data, grid_resolution), sizeof(int32_t));
+        specialization_map_entries_[3] = vk::SpecializationMapEntry(3, offsetof(specialization_data, adaptive_time_step), sizeof(vk::Bool32));
+
+        specialization_info_.mapEntryCount = static_cast<uint32_t>(specialization_map_entries_.size());
+        specialization_info_.pMapEntries = specialization_map_entries_.data();
+        specialization_info_.dataSize = sizeof(specialization_data);
+        specialization_info_.pData = &specialization_data_;
+
+        return &specialization_info_;
+    }
+
+    vk::Pipeline create_compute_pipeline(const std::string& shader_file, vk::PipelineLayout layout) {
+        vk::PipelineShaderStageCreateInfo compute_shader_stage_create_info{};
+        compute_shader_stage_create_info.pSpecializationInfo = &specialization_info_;
+        compute_shader_stage_create_info.pName = "main";
+        compute_shader_stage_create_info.stage = vk::ShaderStageFlagBits::eCompute;
+        compute_shader_stage_create_info.module = load_shader_module(shader_file);
+
+        vk::ComputePipelineCreateInfo compute_pipeline_create_info{};
+        compute_pipeline_create_info.stage = compute_shader_stage_create_info;
+        compute_pipeline_create_info.layout = layout;
+
+        return logical_device_.createComputePipeline(global_pipeline_cache_handle, compute_pipeline_create_info).value;
+    }
+
+    // every pipeline is loaded and compiled on a startup worker while init_vulkan creates the buffers; the ones the
+    // configured simulation records are queued first and init_vulkan only waits for those, the other variants
+    // (other neighbor searches, Morton reorder, adaptive dt) finish in the background
+    void start_pipeline_jobs() {
+        compute_specialization_info();
+
+        const auto search = settings_.neighbor_search;
+        const bool brute_force = search == neighbor_search_mode::brute_force;
+        const bool uniform_grid = search == neighbor_search_mode::uniform_grid;
+        const bool hashed_grid = search == neighbor_search_mode::hashed_grid;
+        const bool verlet_list = search == neighbor_search_mode::verlet_list;
+        const bool reorder = settings_.reorder_interval != 0;
+
+        add_startup_job("particle.vert.spv + particle.frag.spv", true, [this] { create_graphics_pipeline(); });
+
+        auto add_compute = [this](vk::Pipeline& pipeline, const std::string& shader_file, vk::PipelineLayout layout, bool required) {
+            add_startup_job(shader_file, required, [this, &pipeline, shader_file, layout] { pipeline = create_compute_pipeline(shader_file, layout); });
+        };
+
+        // the renderer the run starts with is required, the other one is compiled for the R key in the background;
+        // the splat pass shares the layout of the cull pass
+        const bool points = settings_.renderer == render_mode::points;
+        add_compute(particle_cull_pipeline_, points_renderer_jobs[0], cull_pipeline_layout_, points);
+        add_compute(particle_splat_pipeline_, splat_renderer_jobs[0], cull_pipeline_layout_, !points);
+        add_startup_job(splat_renderer_jobs[1], !points, [this] { create_splat_resolve_pipeline(); });
+
+        // the all-pairs kernels come in a plain and a shared-memory tiled flavour, chosen once here
+        add_compute(density_pipeline_, particle_shader_file(settings_.tiled_all_pairs ? "density_pressure_tiled" : "density_pressure"), compute_pipeline_layout_, brute_force);
+        add_compute(force_pipeline_, particle_shader_file(settings_.tiled_all_pairs ? "force_tiled" : "force"), compute_pipeline_layout_, brute_force);
+        add_compute(position_pipeline_, particle_shader_file("position"), compute_pipeline_layout_, true);
+
+        add_compute(grid_count_pipeline_, "grid_count.comp.spv", compute_pipeline_layout_, uniform_grid || verlet_list);
+        add_compute(grid_scan_pipeline_, "grid_scan.comp.spv", compute_pipeline_layout_, !brute_force);
+        add_compute(grid_scatter_pipeline_, "grid_scatter.comp.spv", compute_pipeline_layout_, !brute_force);
+        add_compute(density_grid_pipeline_, particle_shader_file("density_pressure_grid"), compute_pipeline_layout_, uniform_grid);
+        add_compute(force_grid_pipeline_, particle_shader_file("force_grid"), compute_pipeline_layout_, uniform_grid);
+
+        add_compute(hash_count_pipeline_, "hash_count.comp.spv", compute_pipeline_layout_, hashed_grid);
+        add_compute(density_hash_pipeline_, particle_shader_file("density_pressure_hash"), compute_pipeline_layout_, hashed_grid);
+        add_compute(force_hash_pipeline_, particle_shader_file("force_hash"), compute_pipeline_layout_, hashed_grid);
+
+        add_compute(neighbor_list_displacement_pipeline_, "neighbor_list_displacement.comp.spv", compute_pipeline_layout_, verlet_list);
+        add_compute(neighbor_list_decide_pipeline_, "neighbor_list_decide.comp.spv", compute_pipeline_layout_, verlet_list);
+        add_compute(neighbor_list_build_pipeline_, "neighbor_list_build.comp.spv", compute_pipeline_layout_, verlet_list);
+        add_compute(density_list_pipeline_, particle_shader_file("density_pressure_list"), compute_pipeline_layout_, verlet_list);
+        add_compute(force_list_pipeline_, particle_shader_file("force_list"), compute_pipeline_layout_, verlet_list);
+
+        add_compute(time_step_reduce_pipeline_, particle_shader_file("time_step_reduce"), compute_pipeline_layout_, settings_.adaptive_time_step);
+        add_compute(time_step_update_pipeline_, "time_step_update.comp.spv", compute_pipeline_layout_, settings_.adaptive_time_step);
+
+        // emitters and sinks: removal, compaction, emission and the count update that follows each step
+        const bool dynamic_count = settings_.dynamic_particle_count();
+        add_compute(particle_sink_pipeline_, "particle_sink.comp.spv", compute_pipeline_layout_, dynamic_count);
+        add_compute(compact_scan_pipeline_, "compact_scan.comp.spv", compute_pipeline_layout_, dynamic_count);
+        add_compute(compact_move_pipeline_, particle_shader_file("compact_move"), compute_pipeline_layout_, dynamic_count);
+        add_compute(particle_emit_pipeline_, particle_shader_file("particle_emit"), compute_pipeline_layout_, dynamic_count);
+        add_compute(particle_count_update_pipeline_, "particle_count_update.comp.spv", compute_pipeline_layout_, dynamic_count);
+
+        add_compute(morton_keys_pipeline_, "morton_keys.comp.spv", reorder_pipeline_layout_, reorder);
+        add_compute(bitonic_sort_pipeline_, "bitonic_sort.comp.spv", reorder_pipeline_layout_, reorder);
+        add_compute(reorder_pipeline_, particle_shader_file("reorder"), reorder_pipeline_layout_, reorder);
+
+        std::stable_partition(startup_jobs_.begin(), startup_jobs_.end(), [](const auto& job) { return job->required; });
+
+        size_t worker_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, startup_jobs_.size());
+
+        for (size_t worker = 0; worker < worker_count; ++worker) {
+            startup_workers_.emplace_back([this, worker] {
+                for (size_t i = next_startup_job_++; i < startup_jobs_.size(); i = next_startup_job_++) {
+                    auto& job = *startup_jobs_[i];
+                    job.worker = worker;
+                    job.begin_ms = startup_milliseconds();
+
+                    try {
+                        job.run();
+                        job.end_ms = startup_milliseconds();
+                        job.done.set_value();
+                    }
+                    catch (...) {
+                        job.end_ms = startup_milliseconds();
+                        job.done.set_exception(std::current_exception());
+                    }
+                }
+            });
+        }
+    }
+
+    void add_startup_job(const std::string& name, bool required, std::function<void()> run) {
+        auto job = std::make_unique<startup_job>();
+        job->name = name;
+        job->required = required;
+        job->run = std::move(run);
+        job->finished = job->done.get_future().share();
+
+        startup_jobs_.push_back(std::move(job));
+    }
+
+    void wait_for_required_pipelines() {
+        try {
+            for (const auto& job : startup_jobs_)
+                if (job->required) job->finished.get();
+        }
+        catch (...) {
+            // the workers must not outlive a failed constructor
+            for (auto& worker : startup_workers_)
+                if (worker.joinable()) worker.join();
+            throw;
+        }
+    }
+
+    // phases of init_vulkan and the pipeline jobs on their workers, in ms since init_vulkan started
+    void print_startup_timeline() {
+        std::cout << "startup timeline (" << startup_workers_.size() << " pipeline workers):" << std::endl;
+
+        for (const auto& [phase, ms] : startup_phases_)
+            std::cout << "    " << ms << " ms: " << phase << std::endl;
+
+        for (const auto& job : startup_jobs_) {
+            // only finished jobs may be read, the others still belong to their worker
+            if (job->finished.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                std::cout << "        still compiling in the background: " << job->name << std::endl;
+                continue;
+            }
+
+            std::cout << "        " << job->begin_ms << " - " << job->end_ms << " ms, worker " << job->worker << ": " << job->name
+                << (job->required ? "" : " (background)") << std::endl;
+        }
+    }
+
+    double startup_milliseconds() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startup_begin_).count();
+    }
+
+    // the startup jobs each renderer needs besides the graphics pipeline every run requires
+    static constexpr std::array<std::string_view, 1> points_renderer_jobs{ "particle_cull.comp.spv" };
+    static constexpr std::array<std::string_view, 2> splat_renderer_jobs{ "particle_splat.comp.spv", "splat_resolve.vert.spv + splat_resolve.frag.spv" };
+
+    // waits for the workers without looking at the outcome of their jobs
+    void join_pipeline_jobs() noexcept {
+        for (auto& worker : startup_workers_)
+            if (worker.joinable()) worker.join();
+    }
+
+public:
+    // blocks until every pipeline variant exists; needed before recording anything but the configured simulation, and
+    // rethrows the first variant that failed to compile
+    void wait_for_pipelines() {
+        join_pipeline_jobs();
+
+        for (const auto& job : startup_jobs_)
+            job->finished.get();
+    }
+
+    // blocks until the pipelines of `renderer` exist, rethrowing only their own compile failures
+    void wait_for_renderer_pipelines(render_mode renderer) {
+        const std::span<const std::string_view> names = renderer == render_mode::points
+            ? std::span<const std::string_view>(points_renderer_jobs) : std::span<const std::string_view>(splat_renderer_jobs);
+
+        for (const auto& job : startup_jobs_)
+            if (std::ranges::find(names, job->name) != names.end()) job->finished.get();
+    }
+
+private:
+    void create_compute_command_pool() {
+        vk::CommandPoolCreateInfo create_info{};
+        create_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        create_info.queueFamilyIndex = compute_queue_family_index_;
+
+        compute_command_pool_ = logical_device_.createCommandPool(create_info);
+    }
+
+    void create_compute_command_buffer() {
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = compute_command_pool_;
+        alloc_info.commandBufferCount = 2;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+
+        auto compute_command_buffers = logical_device_.allocateCommandBuffers(alloc_info);
+        auto reorder_command_buffers = logical_device_.allocateCommandBuffers(alloc_info);
+
+        for (uint32_t state = 0; state < 2; ++state) {
+            compute_command_buffers_[state] = compute_command_buffers[state];
+            reorder_command_buffers_[state] = reorder_command_buffers[state];
+        }
+    }
+
+    // only with a trajectory to write: host-visible buffers mapped for the whole run, each with its own command buffer and fence
+    void create_readback_ring() {
+        if (settings_.trajectory_path.empty())
+            return;
+
+        readback_frame_size = position_ssbo_size + velocity_ssbo_size + density_ssbo_size + pressure_ssbo_size;
+
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = compute_command_pool_;
+        alloc_info.commandBufferCount = readback_ring_size;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+
+        auto command_buffers = logical_device_.allocateCommandBuffers(alloc_info);
+
+        for (uint32_t i = 0; i < readback_ring_size; ++i) {
+            readback_slot slot{};
+
+            vk::BufferCreateInfo buffer_create_info{};
+            buffer_create_info.size = readback_frame_size + sizeof(float) + sizeof(uint32_t);
+            buffer_create_info.usage = vk::BufferUsageFlagBits::eTransferDst;
+            buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+            slot.buffer = logical_device_.createBuffer(buffer_create_info);
+
+            // cached memory makes the writer's copy out of the slot a plain memcpy instead of uncached reads
+            slot.memory = allocator_.allocate_buffer(slot.buffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                vk::MemoryPropertyFlagBits::eHostCached);
+            slot.mapped = slot.memory.mapped;
+            slot.command_buffer = command_buffers[i];
+            slot.fence = logical_device_.createFence(vk::FenceCreateInfo{ vk::FenceCreateFlagBits::eSignaled });
+
+            readback_slots_.push_back(slot);
+        }
+    }
+
+    // the batch timestamps are written by two tiny command buffers around the batch, so the recorded step command buffers stay untouched
+    void create_overlap_queries() {
+        if (!overlap_measurable_)
+            return;
+
+        vk::QueryPoolCreateInfo query_pool_info{};
+        query_pool_info.queryType = vk::QueryType::eTimestamp;
+        query_pool_info.queryCount = 4 * MAX_FRAMES_IN_FLIGHT;
+
+        overlap_query_pool_ = logical_device_.createQueryPool(query_pool_info);
+
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = compute_command_pool_;
+        alloc_info.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+
+        batch_begin_command_buffers_ = logical_device_.allocateCommandBuffers(alloc_info);
+        batch_end_command_buffers_ = logical_device_.allocateCommandBuffers(alloc_info);
+
+        for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+            const uint32_t first_query = 4 * frame;
+
+            batch_begin_command_buffers_[frame].begin(vk::CommandBufferBeginInfo{});
+            batch_begin_command_buffers_[frame].resetQueryPool(overlap_query_pool_, first_query, 2);
+            batch_begin_command_buffers_[frame].writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, overlap_query_pool_, first_query);
+            batch_begin_command_buffers_[frame].end();
+
+            batch_end_command_buffers_[frame].begin(vk::CommandBufferBeginInfo{});
+            batch_end_command_buffers_[frame].writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, overlap_query_pool_, first_query + 1);
+            batch_end_command_buffers_[frame].end();
+        }
+    }
+
+    // timestamps are only recorded when an export target was given, the slots follow the queue their command buffers go to
+    void create_profiler() {
+        if (settings_.profile_output.empty())
+            return;
+
+        auto queue_family_properties = physical_device_.getQueueFamilyProperties();
+        uint32_t compute_valid_bits = queue_family_properties[compute_queue_family_index_].timestampValidBits;
+        uint32_t graphics_valid_bits = queue_family_properties[graphics_queue_family_index_].timestampValidBits;
+
+        if (!physical_device_.getProperties().limits.timestampComputeAndGraphics)
+            std::cout << "timestampComputeAndGraphics is not supported, profiling only the queues that report timestamp bits" << std::endl;
+
+        std::vector<uint32_t> slot_valid_bits(graphics_profile_slot + MAX_FRAMES_IN_FLIGHT, compute_valid_bits);
+        std::fill(slot_valid_bits.begin() + graphics_profile_slot, slot_valid_bits.end(), graphics_valid_bits);
+
+        profiler_.create(logical_device_, physical_device_.getProperties().limits.timestampPeriod, slot_valid_bits);
+    }
+
+    // begin and end of a batch or a frame, in device ticks; timestamps of both queues share the device timebase
+    std::array<uint64_t, 2> read_overlap_queries(uint32_t first_query) {
+        std::array<uint64_t, 2> ticks{};
+        auto result = logical_device_.getQueryPoolResults(overlap_query_pool_, first_query, 2, sizeof(ticks), ticks.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+        if (result != vk::Result::eSuccess)
+            return { 0, 0 };
+
+        return ticks;
+    }
+
+private:
+    void submit_one_time_commands(const std::function<void(vk::CommandBuffer)>& record) {
+        submit_one_time_commands(record, compute_queue_, compute_command_pool_);
+    }
+
+    void submit_one_time_commands(const std::function<void(vk::CommandBuffer)>& record, vk::Queue queue, vk::CommandPool command_pool) {
+        vk::CommandBufferAllocateInfo command_buffer_allocate_info{};
+        command_buffer_allocate_info.commandBufferCount = 1;
+        command_buffer_allocate_info.commandPool = command_pool;
+        command_buffer_allocate_info.level = vk::CommandBufferLevel::ePrimary;
+
+        auto command_buffer_handle = logical_device_.allocateCommandBuffers(command_buffer_allocate_info).front();
+
+        vk::CommandBufferBeginInfo begin_info{};
+        begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+        command_buffer_handle.begin(begin_info);
+        record(command_buffer_handle);
+        command_buffer_handle.end();
+
+        vk::SubmitInfo submit_info{};
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &command_buffer_handle;
+
+        queue.submit(submit_info);
+
+        queue.waitIdle();
+
+        logical_device_.freeCommandBuffers(command_pool, { command_buffer_handle });
+    }
+
+    // the SPIR-V embedded by embed_shaders.py, or the .spv files in --shader-dir while working on a shader
+    vk::ShaderModule load_shader_module(const std::string& file_name) {
+        if (settings_.shader_directory.empty()) {
+            for (const auto& shader : embedded_shaders::shaders)
+                if (shader.file_name == file_name)
+                    return create_shader_module(shader.code, shader.code_size);
+
+            throw std::runtime_error("shader not embedded, rerun embed_shaders.py: " + file_name);
+        }
+
+        return create_shader_module_from_file((std::filesystem::path(settings_.shader_directory) / file_name).string());
+    }
+
+    vk::ShaderModule create_shader_module_from_file(const std::string& path_to_file) {
+        std::ifstream shader_file(path_to_file, std::ios::ate | std::ios::binary);
+        if (!shader_file) throw std::runtime_error("shader file load error: " + path_to_file);
+
+        size_t shader_file_size = (size_t)shader_file.tellg();
+        std::vector<uint32_t> shader_code((shader_file_size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+        shader_file.seekg(0);
+        shader_file.read(reinterpret_cast<char*>(shader_code.data()), shader_file_size);
+        shader_file.close();
+
+        return create_shader_module(shader_code.data(), shader_file_size);
+    }
+
+    // code_size in bytes, as vk::ShaderModuleCreateInfo expects it
+    vk::ShaderModule create_shader_module(const uint32_t* code, size_t code_size) {
+        vk::ShaderModuleCreateInfo create_info{};
+        create_info.codeSize = code_size;
+        create_info.pCode = code;
+
+        auto shader_module = logical_device_.createShaderModule(create_info);
+
+        // called from the startup workers
+        std::lock_guard<std::mutex> lock(shader_modules_mutex_);
+        shader_modules_.push_back(shader_module);
+
+        return shader_module;
+    }
+
+public:
+    simulation_settings settings_;
+
+    GLFWwindow* window_;
+    uint32_t window_height_ = 900;
+    uint32_t window_width_ = 1800;
+
+    vk::Instance instance_;
+    VkDebugUtilsMessengerEXT debug_messenger_;
+
+    vk::PhysicalDevice physical_device_;
+    vk::Device logical_device_;
+    vk::SurfaceKHR surface_;
+    vk::SurfaceFormatKHR surface_format_;
+
+    vk::SwapchainKHR swapchain_handle;
+    std::vector<vk::Image> swapchain_images_;
+    std::vector<vk::ImageView> swapchain_image_views_;
+    std::vector<vk::Framebuffer> swapchain_frame_buffers_;
+    vk::Extent2D swapchain_extent_;
+
+    std::vector<vk::ShaderModule> shader_modules_;
+    std::mutex shader_modules_mutex_;
+
+    struct startup_job {
+        std::string name;
+        bool required; // recorded by the configured simulation, init_vulkan waits for it
+        std::function<void()> run;
+        std::promise<void> done;
+        std::shared_future<void> finished;
+        size_t worker = 0;
+        double begin_ms = 0.0;
+        double end_ms = 0.0;
+    };
+
+    std::chrono::high_resolution_clock::time_point startup_begin_;
+    std::vector<std::pair<const char*, double>> startup_phases_;
+    std::vector<std::unique_ptr<startup_job>> startup_jobs_;
+    std::vector<std::thread> startup_workers_;
+    std::atomic<size_t> next_startup_job_{ 0 };
+
+    vk::RenderPass renderpass_;
+
+    uint32_t graphics_queue_family_index_;
+    uint32_t compute_queue_family_index_;
+    uint32_t transfer_queue_family_index_;
+
+    vk::Queue present_queue_;
+    vk::Queue graphics_queue_;
+    vk::Queue compute_queue_;
+    vk::Queue transfer_queue_;
+
+    vk::CommandPool graphics_command_pool_;
+    std::vector<vk::CommandBuffer> graphics_command_buffers_;
+    
+    vk::CommandPool compute_command_pool_;
+    vk::CommandBuffer compute_command_buffers_[2]; // indexed by the ping-pong state the step reads
+    vk::CommandBuffer reorder_command_buffers_[2];
+
+    uint32_t current_state_ = 0; // ping-pong state holding the latest submitted step
+    uint64_t restored_step_ = 0; // the step the restored checkpoint was taken at
+
+    vk::DescriptorPool compute_descriptor_pool_;
+
+    vk::DescriptorSetLayout compute_descriptor_set_layout_;
+    vk::DescriptorSet compute_descriptor_sets_[2];
+    vk::DescriptorSet reorder_source_descriptor_sets_[2];
+
+    vk::PipelineCache global_pipeline_cache_handle;
+
+    vk::Image offscreen_image_; // headless render target
+    memory_allocation offscreen_memory_;
+    bool pipeline_cache_warm_ = false; // seeded from settings_.pipeline_cache_path
+
+    vk::PipelineLayout graphics_pipeline_layout_;
+    vk::Pipeline graphics_pipeline_;
+
+    vk::PipelineLayout compute_pipeline_layout_;
+    vk::Pipeline density_pipeline_;
+    vk::Pipeline force_pipeline_;
+    vk::Pipeline position_pipeline_;
+
+    vk::Pipeline grid_count_pipeline_;
+    vk::Pipeline grid_scan_pipeline_;
+    vk::Pipeline grid_scatter_pipeline_;
+    vk::Pipeline density_grid_pipeline_;
+    vk::Pipeline force_grid_pipeline_;
+
+    vk::Pipeline hash_count_pipeline_;
+    vk::Pipeline density_hash_pipeline_;
+    vk::Pipeline force_hash_pipeline_;
+
+    vk::Pipeline neighbor_list_displacement_pipeline_;
+    vk::Pipeline neighbor_list_decide_pipeline_;
+    vk::Pipeline neighbor_list_build_pipeline_;
+    vk::Pipeline density_list_pipeline_;
+    vk::Pipeline force_list_pipeline_;
+    vk::Pipeline time_step_reduce_pipeline_;
+    vk::Pipeline time_step_update_pipeline_;
+
+    vk::Pipeline particle_sink_pipeline_;
+    vk::Pipeline compact_scan_pipeline_;
+    vk::Pipeline compact_move_pipeline_;
+    vk::Pipeline particle_emit_pipeline_;
+    vk::Pipeline particle_count_update_pipeline_;
+
+    vk::PipelineLayout cull_pipeline_layout_;
+    vk::Pipeline particle_cull_pipeline_;
+    vk::Pipeline particle_splat_pipeline_;
+
+    vk::PipelineLayout splat_resolve_pipeline_layout_;
+    vk::Pipeline splat_resolve_pipeline_;
+
+    vk::PipelineLayout reorder_pipeline_layout_;
+    vk::Pipeline morton_keys_pipeline_;
+    vk::Pipeline bitonic_sort_pipeline_;
+    vk::Pipeline reorder_pipeline_;
+
+    vk::Buffer packed_particles_buffer_;
+    memory_allocation packed_particles_memory_;
+
+    vk::Buffer grid_buffer_;
+    memory_allocation grid_memory_;
+
+    vk::Buffer reorder_buffer_;
+    memory_allocation reorder_memory_;
+
+    vk::Buffer neighbor_list_buffer_;
+    memory_allocation neighbor_list_memory_;
+
+    vk::Buffer neighbor_list_status_buffer_;
+    memory_allocation neighbor_list_status_memory_;
+    neighbor_list_status* neighbor_list_status_; // persistently mapped
+
+    vk::Buffer time_step_buffer_;
+    memory_allocation time_step_memory_;
+    time_step_state* time_step_state_; // persistently mapped
+
+    vk::Buffer particle_count_buffer_;
+    memory_allocation particle_count_memory_;
+    particle_count_state* particle_count_; // persistently mapped
+
+    static constexpr float cull_bin_size = 5.f; // pixels per side of the bins the cull pass decimates in, a point at zoom 1
+    vk::Buffer cull_buffer_;
+    memory_allocation cull_memory_;
+    uint32_t cull_bins_x_ = 0;
+    uint32_t cull_bins_y_ = 0;
+    size_t culled_draw_ssbo_size = 0;
+    size_t cull_bins_ssbo_offset = 0;
+    size_t cull_bins_ssbo_size = 0;
+
+    vk::Buffer splat_buffer_;
+    memory_allocation splat_memory_;
+    size_t splat_ssbo_size = 0;
+
+    struct readback_slot {
+        vk::Buffer buffer;
+        memory_allocation memory;
+        const char* mapped; // persistently mapped
+        vk::CommandBuffer command_buffer;
+        vk::Fence fence; // the copy last submitted into the slot has landed
+    };
+
+    static constexpr uint32_t readback_ring_size = 4; // frames the trajectory writer may fall behind before one is dropped
+    std::vector<readback_slot> readback_slots_;
+    size_t readback_frame_size = 0; // position, velocity, density and pressure bytes of one frame
+
+    vk::Semaphore image_available_semaphore_;
+    vk::Semaphore render_finished_semaphore_;
+
+    uint32_t image_index_;
+
+    std::vector<vk::Semaphore> image_available_semaphores; //an image has been acquired from the swapchain and is ready for rendering
+    std::vector<vk::Semaphore> render_finished_semaphores; //rendering has finished 
+    std::vector<vk::Fence> in_flight_fences; //to make sure only one frame is rendering at a time
+    vk::Fence compute_fence_; //the last batch of simulation steps has finished
+    vk::Semaphore simulation_timeline_; //reaches n + 1 once the batch drawn by frame n has been written
+    vk::Semaphore render_timeline_; //reaches n + 1 once frame n no longer reads the particle state it drew
+
+    // per frame in flight: begin and end of the compute batch, then begin and end of the frame
+    vk::QueryPool overlap_query_pool_;
+    std::vector<vk::CommandBuffer> batch_begin_command_buffers_;
+    std::vector<vk::CommandBuffer> batch_end_command_buffers_;
+    bool overlap_measurable_ = false;
+    float timestamp_period_ = 1.f; // nanoseconds per tick
+
+    // profiler slots: one per recorded compute and reorder command buffer, indexed by state, then one per graphics frame in flight
+    static constexpr uint32_t compute_profile_slot = 0;
+    static constexpr uint32_t reorder_profile_slot = 2;
+    static constexpr uint32_t graphics_profile_slot = 4;
+    gpu_profiler profiler_;
+
+    memory_allocator allocator_;
+
+    static constexpr vk::DeviceSize staging_ring_size = 16 << 20;
+    staging_arena staging_;
+
+    size_t position_ssbo_size;
+    size_t velocity_ssbo_size;
+    size_t force_ssbo_size;
+    size_t density_ssbo_size;
+    size_t pressure_ssbo_size;
+
+    size_t packed_buffer_size;
+    
+    size_t position_ssbo_offset;
+    size_t velocity_ssbo_offset;
+    size_t swap_position_ssbo_offset;
+    size_t swap_velocity_ssbo_offset;
+    size_t force_ssbo_offset;
+    size_t density_ssbo_offset;
+    size_t pressure_ssbo_offset;
+
+    uint32_t grid_resolution_; // cells of size h per side of the bounding box
+
+    // kept alive for as long as pipelines may be created from them
+    specialization_data specialization_data_{};
+    std::array<vk::SpecializationMapEntry, 4> specialization_map_entries_{};
+    vk::SpecializationInfo specialization_info_{};
+    uint32_t grid_cell_count_; // dense cells or hash buckets, depending on the neighbor search
+
+    size_t cell_count_ssbo_size;
+    size_t cell_start_ssbo_size;
+    size_t particle_cell_ssbo_size;
+    size_t sorted_index_ssbo_size;
+
+    size_t grid_buffer_size;
+
+    size_t cell_count_ssbo_offset;
+    size_t cell_start_ssbo_offset;
+    size_t particle_cell_ssbo_offset;
+    size_t sorted_index_ssbo_offset;
+
+    uint32_t morton_key_count_; // particle count rounded up to a power of two for the bitonic sort
+
+    size_t morton_key_ssbo_size;
+    size_t morton_key_ssbo_offset;
+
+    size_t reorder_buffer_size;
+
+    size_t neighbor_index_ssbo_size;
+    size_t neighbor_count_ssbo_size;
+    size_t list_position_ssbo_size;
+
+    size_t neighbor_list_buffer_size;
+
+    size_t neighbor_index_ssbo_offset;
+    size_t neighbor_count_ssbo_offset;
+    size_t list_position_ssbo_offset;
 };
\ No newline at end of file
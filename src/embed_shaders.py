@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Compiles every shader next to this script and embeds the optimized SPIR-V into embedded_shaders.hpp.
+
+Usage: python3 embed_shaders.py [--glslc PATH] [--spirv-opt PATH]
+
+Each .comp, .vert and .frag is compiled with glslc and run through spirv-opt -O. Compute shaders that include
+compact_storage.glsl are built a second time with -DCOMPACT_STORAGE into <name>.compact.comp.spv, the fp16 particle layout.
+Included .glsl files are resolved next to the shader that includes them and are not compiled on their own.
+The .spv files are written next to the sources as well, so `--shader-dir` can still load them from disk while iterating
+on a shader without rebuilding the binary.
+"""
+
+import argparse
+import pathlib
+import subprocess
+import sys
+
+SHADER_DIR = pathlib.Path(__file__).resolve().parent
+HEADER = SHADER_DIR / "embedded_shaders.hpp"
+COMPACT_STORAGE_INCLUDE = '#include "compact_storage.glsl"'
+
+
+def compile_shader(glslc, spirv_opt, source, output, defines):
+    unoptimized = output.with_suffix(".unoptimized.spv")
+
+    subprocess.run([glslc, "--target-env=vulkan1.2", *(f"-D{define}" for define in defines), str(source), "-o", str(unoptimized)], check=True)
+    subprocess.run([spirv_opt, "-O", str(unoptimized), "-o", str(output)], check=True)
+
+    unoptimized.unlink()
+    return output.read_bytes()
+
+
+def identifier(file_name):
+    return file_name.replace(".", "_")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--glslc", default="glslc")
+    parser.add_argument("--spirv-opt", default="spirv-opt")
+    args = parser.parse_args()
+
+    shaders = []
+
+    for source in sorted(SHADER_DIR.glob("*.comp")) + sorted(SHADER_DIR.glob("*.vert")) + sorted(SHADER_DIR.glob("*.frag")):
+        variants = [(source.name + ".spv", [])]
+
+        if source.suffix == ".comp" and COMPACT_STORAGE_INCLUDE in source.read_text():
+            variants.append((source.stem + ".compact.comp.spv", ["COMPACT_STORAGE"]))
+
+        for file_name, defines in variants:
+            code = compile_shader(args.glslc, args.spirv_opt, source, SHADER_DIR / file_name, defines)
+
+            if len(code) % 4:
+                sys.exit(f"{file_name}: SPIR-V size is not a multiple of 4")
+
+            shaders.append((file_name, code))
+
+    lines = [
+        "#pragma once",
+        "// generated by embed_shaders.py from the shader sources next to it, do not edit",
+        "",
+        "#include <cstddef>",
+        "#include <cstdint>",
+        "#include <string_view>",
+        "",
+        "namespace embedded_shaders {",
+    ]
+
+    for file_name, code in shaders:
+        words = [int.from_bytes(code[i:i + 4], "little") for i in range(0, len(code), 4)]
+        rows = [", ".join(f"0x{word:08x}" for word in words[i:i + 8]) for i in range(0, len(words), 8)]
+
+        lines.append(f"    inline constexpr uint32_t {identifier(file_name)}[] = {{")
+        lines.extend(f"        {row}," for row in rows)
+        lines.append("    };")
+        lines.append("")
+
+    lines.extend([
+        "    struct shader {",
+        "        std::string_view file_name; // the .spv it was built as, which is how the device context asks for it",
+        "        const uint32_t* code;",
+        "        size_t code_size; // in bytes",
+        "    };",
+        "",
+        "    inline constexpr shader shaders[] = {",
+    ])
+    lines.extend(f"        {{ \"{file_name}\", {identifier(file_name)}, sizeof({identifier(file_name)}) }}," for file_name, _ in shaders)
+    lines.extend([
+        "    };",
+        "}",
+        "",
+    ])
+
+    HEADER.write_text("\n".join(lines))
+    print(f"embedded {len(shaders)} shaders into {HEADER.name}")
+
+
+if __name__ == "__main__":
+    main()
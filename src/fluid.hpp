@@ -1,21 +1,78 @@
-#include "config.hpp"
-
-struct fluid {
-	static auto generate_initial_positions(int num, float radius = 0.005f) {
-		std::vector<glm::vec2> initial_positions(num); 
-
-		for (int i = 0, x = 0, y = 0; i < num; ++i) {
-			initial_positions[i].x = -0.625f + radius * 2 * x;
-			initial_positions[i].y = -1 + radius * 2 * y;
-			
-			++x;
-
-			if (x >= 125) {
-				x = 0;
-				++y;
-			}
-		}
-
-		return initial_positions;
-	}
+#pragma once
+#include "settings.hpp"
+
+struct particle_snapshot {
+	std::vector<glm::vec2> position;
+	std::vector<glm::vec2> velocity;
+	std::vector<glm::vec2> force;
+	std::vector<float> density;
+	std::vector<float> pressure;
+};
+
+struct fluid {
+	static auto generate_initial_positions(int num, float radius = 0.005f) {
+		std::vector<glm::vec2> initial_positions(num); 
+
+		// a block 1.25 wide, whatever the particle size
+		const int columns = static_cast<int>(1.25f / (radius * 2));
+
+		for (int i = 0, x = 0, y = 0; i < num; ++i) {
+			initial_positions[i].x = -0.625f + radius * 2 * x;
+			initial_positions[i].y = -1 + radius * 2 * y;
+			
+			++x;
+
+			if (x >= columns) {
+				x = 0;
+				++y;
+			}
+		}
+
+		return initial_positions;
+	}
+
+	// a handful of small blocks spread over the box, most of the domain stays empty: the box is cut into 4 x 2 cells and
+	// each cluster is a block a diameter apart centred in its cell, at least a radius off the walls and the other cells
+	static auto generate_sparse_positions(int num, float radius, glm::vec2 bounding_box) {
+		std::vector<glm::vec2> initial_positions(num);
+
+		const glm::ivec2 cells{ 4, 2 };
+		const int clusters = cells.x * cells.y;
+		const float spacing = radius * 2;
+
+		const glm::vec2 cell_size = 2.f * bounding_box / glm::vec2(cells);
+		const int cell_columns = static_cast<int>(std::floor((cell_size.x - spacing) / spacing)) + 1;
+		const int cell_rows = static_cast<int>(std::floor((cell_size.y - spacing) / spacing)) + 1;
+
+		const int per_cluster = (num + clusters - 1) / clusters;
+
+		if (cell_columns < 1 || cell_rows < 1 || per_cluster > cell_columns * cell_rows)
+			throw std::runtime_error(std::to_string(num) + " particles of radius " + std::to_string(radius) + " do not fit the sparse distribution of this box");
+
+		// square blocks, widened until the rows fit the cell
+		const int columns = std::max(std::min(cell_columns, static_cast<int>(std::ceil(std::sqrt(static_cast<float>(per_cluster))))),
+			(per_cluster + cell_rows - 1) / cell_rows);
+		const int rows = (per_cluster + columns - 1) / columns;
+		const glm::vec2 block_size = spacing * glm::vec2(columns - 1, rows - 1);
+
+		for (int i = 0; i < num; ++i) {
+			int cluster = i % clusters;
+			int index = i / clusters;
+
+			glm::vec2 cell_center = -bounding_box + cell_size * (glm::vec2(cluster % cells.x, cluster / cells.x) + 0.5f);
+			glm::vec2 origin = cell_center - 0.5f * block_size;
+
+			initial_positions[i].x = origin.x + spacing * (index % columns);
+			initial_positions[i].y = origin.y + spacing * (index / columns);
+		}
+
+		return initial_positions;
+	}
+
+	// the initial state of a run, shared by the GPU context and the CPU solver so both start from the same particles
+	static auto generate_positions(const simulation_settings& settings) {
+		return settings.distribution == particle_distribution::sparse
+			? generate_sparse_positions(settings.particle_count, settings.params.radius, settings.params.bounding_box)
+			: generate_initial_positions(settings.particle_count, settings.params.radius);
+	}
 };
\ No newline at end of file
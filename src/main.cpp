@@ -1,11 +1,271 @@
-﻿#include "render_system.hpp"
-
-int main(int argc, char** argv){
-    try {
-        render_system app{};
-        app.run();
-    }
-    catch (std::runtime_error& e) {
-        std::cout << e.what();
-    }
+﻿#include "render_system.hpp"
+#include "cpu_solver.hpp"
+
+#include <optional>
+
+// the particle count above which the grid beats the all-pairs kernels, with and without shared-memory tiles
+void run_crossover_benchmark(const simulation_settings& settings) {
+    auto step_time = [&](uint32_t particle_count, neighbor_search_mode neighbor_search, bool tiled_all_pairs) {
+        auto benchmark_settings = settings;
+        benchmark_settings.particle_count = particle_count;
+        benchmark_settings.neighbor_search = neighbor_search;
+        benchmark_settings.tiled_all_pairs = tiled_all_pairs;
+
+        render_system benchmark{ benchmark_settings };
+        return benchmark.measure_step_time(settings.crossover_benchmark_steps);
+    };
+
+    std::cout << "particles, all-pairs ms/step, tiled all-pairs ms/step, uniform-grid ms/step, fastest" << std::endl;
+
+    for (uint32_t particle_count = 512; particle_count <= 32768; particle_count *= 2) {
+        double all_pairs = step_time(particle_count, neighbor_search_mode::brute_force, false);
+        double tiled_all_pairs = step_time(particle_count, neighbor_search_mode::brute_force, true);
+        double uniform_grid = step_time(particle_count, neighbor_search_mode::uniform_grid, false);
+
+        const char* fastest = "uniform-grid";
+        if (all_pairs < std::min(tiled_all_pairs, uniform_grid)) fastest = "all-pairs";
+        else if (tiled_all_pairs < uniform_grid) fastest = "tiled all-pairs";
+
+        std::cout << particle_count << ", " << all_pairs << ", " << tiled_all_pairs << ", " << uniform_grid << ", " << fastest << std::endl;
+    }
+}
+
+// ms per offscreen frame of the point pipeline and of the compute rasterizer, both drawing the same initial state
+void run_render_benchmark(const simulation_settings& settings) {
+    std::cout << "particles, points ms/frame, splat ms/frame, faster" << std::endl;
+
+    for (uint32_t particle_count = 16384; particle_count <= 1048576; particle_count *= 4) {
+        auto benchmark_settings = settings;
+        benchmark_settings.particle_count = particle_count;
+        benchmark_settings.headless = true;
+
+        render_system benchmark{ benchmark_settings };
+        double points = benchmark.measure_frame_time(render_mode::points, settings.render_benchmark_frames);
+        double splat = benchmark.measure_frame_time(render_mode::splat, settings.render_benchmark_frames);
+
+        std::cout << particle_count << ", " << points << ", " << splat << ", " << (points <= splat ? "points" : "splat") << std::endl;
+    }
+}
+
+// how far the fp16 layout drifts from the fp32 layout over the same steps, and what it saves
+void run_precision_benchmark(const simulation_settings& settings) {
+    auto run = [&](bool compact_storage) {
+        auto benchmark_settings = settings;
+        benchmark_settings.compact_storage = compact_storage;
+
+        render_system benchmark{ benchmark_settings };
+        if (benchmark.compact_storage() != compact_storage)
+            throw std::runtime_error("the device does not support the compact particle layout");
+
+        double ms_per_step = benchmark.measure_step_time(settings.precision_benchmark_steps);
+        std::cout << (compact_storage ? "compact" : "fp32") << ": " << benchmark.bytes_per_particle() << " bytes/particle, " << ms_per_step << " ms/step" << std::endl;
+
+        return benchmark.simulate(settings.precision_benchmark_steps);
+    };
+
+    auto reference = run(false);
+    auto compact = run(true);
+
+    float max_drift = 0.f;
+    double mean_drift = 0.0;
+
+    for (size_t i = 0; i < reference.position.size(); ++i) {
+        float drift = glm::length(reference.position[i] - compact.position[i]);
+        max_drift = std::max(max_drift, drift);
+        mean_drift += drift;
+    }
+    mean_drift /= reference.position.size();
+
+    std::cout << "position drift after " << settings.precision_benchmark_steps << " steps: max " << max_drift << ", mean " << mean_drift
+        << " (" << max_drift / settings.params.radius << " particle radii)" << std::endl;
+}
+
+// the headless loop of render_system on the CPU solver, for machines without a usable Vulkan device
+void run_cpu_simulation(const simulation_settings& settings) {
+    uint64_t steps = settings.headless_steps;
+    if (settings.headless_time > 0.f)
+        steps = std::max<uint64_t>(steps, static_cast<uint64_t>(std::ceil(settings.headless_time / settings.params.dt)));
+
+    if (steps == 0)
+        throw std::runtime_error("--cpu needs --steps or --simulated-time");
+
+    cpu_solver solver{ fluid::generate_positions(settings), settings, settings.cpu_threads };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    solver.run(steps);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << "cpu (" << solver.thread_count() << " threads, " << solver.instruction_set() << "): " << steps << " steps, "
+        << steps * settings.params.dt << " s simulated in " << elapsed.count() << " s, " << steps / elapsed.count() << " steps/s, "
+        << steps * solver.particle_count() / elapsed.count() << " particle-steps/s, " << solver.block_count() << " cell blocks in the last step" << std::endl;
+
+    solver.scheduler().print_utilization(std::cout);
+}
+
+// particles * steps per second of the CPU solver, scalar and vectorized, from one thread up to every hardware thread
+void run_cpu_benchmark(const simulation_settings& settings) {
+    const uint32_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const auto positions = fluid::generate_positions(settings);
+
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t threads = 1; threads < hardware_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(hardware_threads);
+
+    std::vector<bool> vectorized = { false };
+    if (cpu_simd::native_batch::width > 1)
+        vectorized.push_back(true);
+
+    std::cout << "threads, instruction set, ms/step, particle-steps/s, cell blocks, mean thread utilization %" << std::endl;
+
+    for (uint32_t threads : thread_counts)
+        for (bool simd : vectorized) {
+            cpu_solver solver{ positions, settings, threads, simd };
+
+            // the first step touches every scratch array once
+            solver.step();
+            solver.reset_scheduler_stats();
+
+            auto start = std::chrono::high_resolution_clock::now();
+            solver.run(settings.cpu_benchmark_steps);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            std::cout << threads << ", " << solver.instruction_set() << ", " << 1000.0 * elapsed.count() / settings.cpu_benchmark_steps << ", "
+                << static_cast<double>(settings.cpu_benchmark_steps) * solver.particle_count() / elapsed.count() << ", " << solver.block_count() << ", "
+                << 100.0 * solver.scheduler().mean_utilization() << std::endl;
+        }
+}
+
+// runs the configured GPU path and the CPU solver for the same steps from the same state and compares every field
+bool run_cpu_validation(const simulation_settings& settings) {
+    if (settings.adaptive_time_step)
+        throw std::runtime_error("--validate-cpu needs a fixed time step");
+
+    // a Morton reorder would permute the GPU particles against the CPU ones
+    auto gpu_settings = settings;
+    gpu_settings.reorder_interval = 0;
+
+    render_system gpu{ gpu_settings };
+    auto reference = gpu.simulate(settings.cpu_validation_steps);
+
+    cpu_solver solver{ fluid::generate_positions(settings), settings, settings.cpu_threads };
+    solver.run(settings.cpu_validation_steps);
+    auto candidate = solver.snapshot();
+
+    // errors relative to the largest magnitude of the field, since single particles sit near zero pressure and force;
+    // the fp16 layout rounds density, pressure and velocity to 11 significant bits
+    const float tolerance = gpu.compact_storage() ? 1e-2f : 1e-3f;
+
+    auto max_error = [](const auto& expected, const auto& actual, auto magnitude) {
+        float largest = 0.f;
+        float error = 0.f;
+
+        for (size_t i = 0; i < expected.size(); ++i) {
+            largest = std::max(largest, magnitude(expected[i]));
+            error = std::max(error, magnitude(expected[i] - actual[i]));
+        }
+
+        return error / std::max(largest, 1e-6f);
+    };
+
+    auto scalar = [](float value) { return std::abs(value); };
+    auto vector = [](glm::vec2 value) { return glm::length(value); };
+
+    float density_error = max_error(reference.density, candidate.density, scalar);
+    float pressure_error = max_error(reference.pressure, candidate.pressure, scalar);
+    float force_error = max_error(reference.force, candidate.force, vector);
+    float velocity_error = max_error(reference.velocity, candidate.velocity, vector);
+
+    // positions against the particle radius rather than the box
+    float position_error = 0.f;
+    for (size_t i = 0; i < reference.position.size(); ++i)
+        position_error = std::max(position_error, glm::length(reference.position[i] - candidate.position[i]) / settings.params.radius);
+
+    bool passed = density_error < tolerance && pressure_error < tolerance && force_error < tolerance && velocity_error < tolerance
+        && position_error < tolerance;
+
+    std::cout << "cpu validation against " << to_string(settings.neighbor_search) << (gpu.compact_storage() ? " compact" : "") << " after "
+        << settings.cpu_validation_steps << " steps (" << reference.position.size() << " particles): density " << density_error
+        << ", pressure " << pressure_error << ", force " << force_error << ", velocity " << velocity_error << ", position "
+        << position_error << " radii" << (passed ? " -> PASSED" : " -> FAILED") << std::endl;
+
+    return passed;
+}
+
+int main(int argc, char** argv){
+    try {
+        auto settings = parse_command_line(argc, argv);
+
+        if (!settings.restore_path.empty())
+            adopt_checkpoint_layout(settings);
+
+        if (settings.crossover_benchmark_steps) {
+            run_crossover_benchmark(settings);
+            return 0;
+        }
+
+        if (settings.precision_benchmark_steps) {
+            run_precision_benchmark(settings);
+            return 0;
+        }
+
+        if (settings.render_benchmark_frames) {
+            run_render_benchmark(settings);
+            return 0;
+        }
+
+        if (settings.cpu_benchmark_steps) {
+            run_cpu_benchmark(settings);
+            return 0;
+        }
+
+        if (settings.cpu_validation_steps)
+            return run_cpu_validation(settings) ? 0 : 1;
+
+        if (settings.cpu_solver) {
+            run_cpu_simulation(settings);
+            return 0;
+        }
+
+        if (settings.benchmark_steps) {
+            // the neighbor structure is fixed at construction, so every configuration gets its own context
+            for (auto neighbor_search : { neighbor_search_mode::uniform_grid, neighbor_search_mode::hashed_grid, neighbor_search_mode::verlet_list })
+                for (auto distribution : { particle_distribution::block, particle_distribution::sparse }) {
+                    auto benchmark_settings = settings;
+                    benchmark_settings.neighbor_search = neighbor_search;
+                    benchmark_settings.distribution = distribution;
+
+                    render_system benchmark{ benchmark_settings };
+                    benchmark.benchmark_neighbor_search();
+                }
+            return 0;
+        }
+
+        std::optional<render_system> app;
+
+        try {
+            app.emplace(settings);
+        }
+        catch (std::runtime_error& e) {
+            // a plain headless run does not need the device, only its results
+            bool cpu_can_run = settings.headless && !settings.validate_neighbor_search && !settings.adaptive_time_step && settings.offscreen_image.empty()
+                && settings.trajectory_path.empty() && settings.checkpoint_path.empty() && settings.restore_path.empty() && !settings.dynamic_particle_count();
+            if (!cpu_can_run) throw;
+
+            std::cout << e.what() << std::endl << "no usable Vulkan device, falling back to the CPU solver" << std::endl;
+            run_cpu_simulation(settings);
+            return 0;
+        }
+
+        if (settings.validate_neighbor_search)
+            return app->validate_neighbor_search() ? 0 : 1;
+
+        if (settings.headless)
+            app->run_headless();
+        else
+            app->run();
+    }
+    catch (std::runtime_error& e) {
+        std::cout << e.what();
+    }
 }
\ No newline at end of file
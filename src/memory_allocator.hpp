@@ -0,0 +1,280 @@
+#pragma once
+#include "config.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <optional>
+#include <vector>
+
+struct memory_allocation {
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    char* mapped = nullptr; // host visible blocks stay mapped as long as they live, this points at offset
+    uint32_t block = UINT32_MAX;
+
+    explicit operator bool() const {
+        return block != UINT32_MAX;
+    }
+};
+
+// Suballocates buffers and images out of a few large vkDeviceMemory blocks per memory type, so the number of device
+// allocations stays far below maxMemoryAllocationCount however many buffers there are. Each block keeps a sorted list
+// of free ranges that is searched first fit at the alignment of the request and coalesced on free. Buffers and images
+// never share a block, which keeps bufferImageGranularity out of the picture. Requests over half a block get a block of
+// their own, released as soon as they are freed; an emptied block is kept only while it is the last one of its kind.
+// Host visible blocks are mapped once when they are allocated, since a memory object cannot be mapped twice. Only used
+// from the thread that owns the device.
+class memory_allocator {
+public:
+    static constexpr vk::DeviceSize default_block_size = 64ull << 20;
+
+    void create(vk::PhysicalDevice physical_device, vk::Device device) {
+        device_ = device;
+        memory_properties_ = physical_device.getMemoryProperties();
+        max_allocations_ = physical_device.getProperties().limits.maxMemoryAllocationCount;
+    }
+
+    // every allocation must have been freed or be abandoned with the device
+    void destroy() {
+        for (auto& block : blocks_)
+            if (block.memory)
+                device_.freeMemory(block.memory);
+
+        blocks_.clear();
+    }
+
+    // the type allowed by `supported_types` with every `required` property and the most `preferred` ones
+    uint32_t find_memory_type(uint32_t supported_types, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {}) const {
+        int best_type = -1;
+        int best_score = -1;
+
+        for (uint32_t type = 0; type < memory_properties_.memoryTypeCount; ++type) {
+            auto flags = memory_properties_.memoryTypes[type].propertyFlags;
+            if (!(supported_types & (1u << type)) || (flags & required) != required) continue;
+
+            int score = std::popcount(static_cast<uint32_t>(flags & preferred));
+            if (score > best_score) {
+                best_type = static_cast<int>(type);
+                best_score = score;
+            }
+        }
+
+        if (best_type < 0)
+            throw std::runtime_error("failed to find suitable memory type!");
+
+        return static_cast<uint32_t>(best_type);
+    }
+
+    memory_allocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {}, bool image = false) {
+        const uint32_t type = find_memory_type(requirements.memoryTypeBits, required, preferred);
+        const bool dedicated = requirements.size > block_size(type) / 2;
+
+        if (!dedicated)
+            for (uint32_t index = 0; index < blocks_.size(); ++index) {
+                const auto& block = blocks_[index];
+                if (!block.memory || block.dedicated || block.type != type || block.image != image) continue;
+
+                if (auto allocation = suballocate(index, requirements))
+                    return *allocation;
+            }
+
+        uint32_t index = create_block(type, dedicated ? requirements.size : block_size(type), dedicated, image);
+        return *suballocate(index, requirements);
+    }
+
+    memory_allocation allocate_buffer(vk::Buffer buffer, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {}) {
+        auto allocation = allocate(device_.getBufferMemoryRequirements(buffer), required, preferred);
+        device_.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+        return allocation;
+    }
+
+    memory_allocation allocate_image(vk::Image image, vk::MemoryPropertyFlags required) {
+        auto allocation = allocate(device_.getImageMemoryRequirements(image), required, {}, true);
+        device_.bindImageMemory(image, allocation.memory, allocation.offset);
+        return allocation;
+    }
+
+    // returns the range to its block and resets `allocation`
+    void free(memory_allocation& allocation) {
+        if (!allocation) return;
+
+        auto& block = blocks_[allocation.block];
+        block.used -= allocation.size;
+        --block.allocations;
+
+        if (block.allocations == 0 && (block.dedicated || spare_block(allocation.block))) {
+            device_.freeMemory(block.memory);
+            block = memory_block{};
+        }
+        else {
+            auto next = std::lower_bound(block.free.begin(), block.free.end(), allocation.offset, [](const free_range& range, vk::DeviceSize offset) {
+                return range.offset < offset;
+            });
+            next = block.free.insert(next, { allocation.offset, allocation.size });
+
+            if (next + 1 != block.free.end() && next->offset + next->size == (next + 1)->offset) {
+                next->size += (next + 1)->size;
+                block.free.erase(next + 1);
+            }
+
+            if (next != block.free.begin() && (next - 1)->offset + (next - 1)->size == next->offset) {
+                (next - 1)->size += next->size;
+                block.free.erase(next);
+            }
+        }
+
+        allocation = memory_allocation{};
+    }
+
+    vk::DeviceSize used_bytes() const {
+        vk::DeviceSize used = 0;
+        for (const auto& block : blocks_)
+            used += block.used;
+
+        return used;
+    }
+
+    void print_usage(std::ostream& out) const {
+        vk::DeviceSize reserved = 0;
+        uint32_t block_count = 0;
+        uint32_t allocation_count = 0;
+
+        for (const auto& block : blocks_) {
+            if (!block.memory) continue;
+
+            reserved += block.size;
+            ++block_count;
+            allocation_count += block.allocations;
+        }
+
+        out << "    GPU memory: " << used_bytes() / 1048576.0 << " MB in " << allocation_count << " allocations, " << reserved / 1048576.0
+            << " MB reserved in " << block_count << " device allocations (at most " << max_allocations_ << ")" << std::endl;
+
+        for (uint32_t type = 0; type < memory_properties_.memoryTypeCount; ++type) {
+            vk::DeviceSize type_used = 0;
+            vk::DeviceSize type_reserved = 0;
+            uint32_t type_blocks = 0;
+
+            for (const auto& block : blocks_) {
+                if (!block.memory || block.type != type) continue;
+
+                type_used += block.used;
+                type_reserved += block.size;
+                ++type_blocks;
+            }
+
+            if (type_blocks == 0) continue;
+
+            out << "    memory type " << type << " " << vk::to_string(memory_properties_.memoryTypes[type].propertyFlags) << ": " << type_used / 1048576.0
+                << " of " << type_reserved / 1048576.0 << " MB used in " << type_blocks << " blocks" << std::endl;
+        }
+    }
+
+private:
+    struct free_range {
+        vk::DeviceSize offset;
+        vk::DeviceSize size;
+    };
+
+    struct memory_block {
+        vk::DeviceMemory memory; // null once a dedicated block was released, the slot is reused
+        uint32_t type = 0;
+        vk::DeviceSize size = 0;
+        vk::DeviceSize used = 0;
+        uint32_t allocations = 0;
+        bool dedicated = false;
+        bool image = false;
+        char* mapped = nullptr;
+        std::vector<free_range> free; // sorted by offset, never adjacent
+    };
+
+    // a heap smaller than eight blocks, like a 256 MB window of device local host visible memory, gets smaller blocks
+    vk::DeviceSize block_size(uint32_t type) const {
+        auto heap_size = memory_properties_.memoryHeaps[memory_properties_.memoryTypes[type].heapIndex].size;
+        return std::min(default_block_size, std::max<vk::DeviceSize>(heap_size / 8, 1ull << 20));
+    }
+
+    // whether another live block could take the place of an empty one
+    bool spare_block(uint32_t index) const {
+        const auto& empty = blocks_[index];
+
+        for (uint32_t other = 0; other < blocks_.size(); ++other)
+            if (other != index && blocks_[other].memory && !blocks_[other].dedicated && blocks_[other].type == empty.type && blocks_[other].image == empty.image)
+                return true;
+
+        return false;
+    }
+
+    uint32_t create_block(uint32_t type, vk::DeviceSize size, bool dedicated, bool image) {
+        uint32_t live_blocks = 0;
+        for (const auto& block : blocks_)
+            live_blocks += block.memory ? 1 : 0;
+
+        if (live_blocks >= max_allocations_)
+            throw std::runtime_error("maxMemoryAllocationCount (" + std::to_string(max_allocations_) + ") reached");
+
+        memory_block block{};
+        block.type = type;
+        block.size = size;
+        block.dedicated = dedicated;
+        block.image = image;
+        block.free.push_back({ 0, size });
+
+        vk::MemoryAllocateInfo allocate_info{};
+        allocate_info.allocationSize = size;
+        allocate_info.memoryTypeIndex = type;
+
+        block.memory = device_.allocateMemory(allocate_info);
+
+        if (memory_properties_.memoryTypes[type].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+            block.mapped = static_cast<char*>(device_.mapMemory(block.memory, 0, size));
+
+        for (uint32_t index = 0; index < blocks_.size(); ++index)
+            if (!blocks_[index].memory) {
+                blocks_[index] = std::move(block);
+                return index;
+            }
+
+        blocks_.push_back(std::move(block));
+        return static_cast<uint32_t>(blocks_.size() - 1);
+    }
+
+    std::optional<memory_allocation> suballocate(uint32_t index, const vk::MemoryRequirements& requirements) {
+        auto& block = blocks_[index];
+        const vk::DeviceSize alignment = std::max<vk::DeviceSize>(requirements.alignment, 1);
+
+        for (auto range = block.free.begin(); range != block.free.end(); ++range) {
+            vk::DeviceSize offset = (range->offset + alignment - 1) / alignment * alignment;
+            vk::DeviceSize range_end = range->offset + range->size;
+
+            if (offset + requirements.size > range_end) continue;
+
+            // the padding in front stays free, and so does whatever is left behind
+            free_range before{ range->offset, offset - range->offset };
+            free_range after{ offset + requirements.size, range_end - offset - requirements.size };
+
+            range = block.free.erase(range);
+            if (after.size) range = block.free.insert(range, after);
+            if (before.size) block.free.insert(range, before);
+
+            block.used += requirements.size;
+            ++block.allocations;
+
+            memory_allocation allocation{};
+            allocation.memory = block.memory;
+            allocation.offset = offset;
+            allocation.size = requirements.size;
+            allocation.mapped = block.mapped ? block.mapped + offset : nullptr;
+            allocation.block = index;
+            return allocation;
+        }
+
+        return std::nullopt;
+    }
+
+    vk::Device device_;
+    vk::PhysicalDeviceMemoryProperties memory_properties_;
+    uint32_t max_allocations_ = 4096;
+    std::vector<memory_block> blocks_;
+};
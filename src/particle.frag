@@ -1,7 +1,7 @@
-#version 460
-
-layout(location = 0) out vec4 frag_color;
-
-void main() {
-    frag_color = vec4(0.0, 127.0 / 255.0, 1.0, 1.0);
+#version 460
+
+layout(location = 0) out vec4 frag_color;
+
+void main() {
+    frag_color = vec4(0.0, 127.0 / 255.0, 1.0, 1.0);
 }
\ No newline at end of file
@@ -1,8 +1,15 @@
-#version 460
-
-layout (location = 0) in vec2 position;
-
-void main (){
-    gl_Position = vec4(position.x, position.y, 0.0, 1.0);
-    gl_PointSize = 5;
+#version 460
+
+layout (location = 0) in vec2 position;
+
+// the head of the view parameters of particle_cull.comp
+layout(push_constant) uniform view_parameters {
+    vec2 center; // of the view, in simulation units
+    vec2 scale; // clip space units per simulation unit
+    float point_size; // pixels
+};
+
+void main (){
+    gl_Position = vec4((position - center) * scale, 0.0, 1.0);
+    gl_PointSize = point_size;
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+#pragma once
+#include "config.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// GPU timestamps around the passes of recorded command buffers. Each command buffer records into its own slot of the
+// query pool and resets that slot when it starts, so a command buffer replayed several times in one batch leaves the
+// timings of its last run. A slot is read back only after the fence of its submission was waited for anyway, which
+// keeps the GPU from ever stalling on a query.
+class gpu_profiler {
+public:
+    static constexpr uint32_t max_stages_per_slot = 32;
+    static constexpr size_t window_size = 512; // samples per stage the rolling statistics cover
+
+    struct stage_stats {
+        std::string name;
+        size_t samples;
+        double min_ms;
+        double mean_ms;
+        double p99_ms;
+    };
+
+    // one entry per slot, the timestampValidBits of the queue family the slot is submitted to; 0 leaves the slot untimed
+    void create(vk::Device device, float timestamp_period, const std::vector<uint32_t>& slot_valid_bits) {
+        device_ = device;
+        timestamp_period_ = timestamp_period;
+
+        slots_.resize(slot_valid_bits.size());
+
+        bool any_valid = false;
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].valid_mask = slot_valid_bits[i] >= 64 ? ~0ull : (1ull << slot_valid_bits[i]) - 1;
+            any_valid |= slot_valid_bits[i] > 0;
+        }
+
+        if (!any_valid) {
+            std::cout << "GPU timestamps are not supported on these queues, profiling is disabled" << std::endl;
+            return;
+        }
+
+        vk::QueryPoolCreateInfo query_pool_info{};
+        query_pool_info.queryType = vk::QueryType::eTimestamp;
+        query_pool_info.queryCount = static_cast<uint32_t>(slots_.size()) * 2 * max_stages_per_slot;
+
+        query_pool_ = device_.createQueryPool(query_pool_info);
+    }
+
+    void destroy() {
+        if (query_pool_)
+            device_.destroyQueryPool(query_pool_);
+
+        query_pool_ = nullptr;
+    }
+
+    bool enabled() const {
+        return static_cast<bool>(query_pool_);
+    }
+
+    // called at the start of a command buffer, every begin/end pair that follows is timed into `slot`
+    void begin_recording(vk::CommandBuffer command_buffer, uint32_t slot) {
+        current_slot_ = slot;
+
+        if (!recording_enabled()) return;
+
+        // re-recording implies the previous submission has completed
+        collect(slot);
+
+        slots_[slot].stages.clear();
+        command_buffer.resetQueryPool(query_pool_, first_query(slot), 2 * max_stages_per_slot);
+    }
+
+    // bottom of pipe on both ends: the stage starts once everything before it has finished
+    void begin(vk::CommandBuffer command_buffer, const char* name) {
+        if (!recording_enabled() || slots_[current_slot_].stages.size() == max_stages_per_slot) return;
+
+        auto& slot = slots_[current_slot_];
+        slot.stages.push_back(stage_index(name));
+        slot.open = true;
+
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool_, first_query(current_slot_) + 2 * static_cast<uint32_t>(slot.stages.size() - 1));
+    }
+
+    void end(vk::CommandBuffer command_buffer) {
+        if (!recording_enabled() || !slots_[current_slot_].open) return;
+
+        auto& slot = slots_[current_slot_];
+        slot.open = false;
+
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool_, first_query(current_slot_) + 2 * static_cast<uint32_t>(slot.stages.size() - 1) + 1);
+    }
+
+    void submitted(uint32_t slot) {
+        if (slot < slots_.size())
+            slots_[slot].pending = true;
+    }
+
+    // reads the timestamps of the last submission of `slot`, which must have completed
+    void collect(uint32_t slot) {
+        if (!enabled() || slot >= slots_.size() || !slots_[slot].pending) return;
+
+        auto& recorded = slots_[slot];
+        recorded.pending = false;
+
+        if (recorded.stages.empty()) return;
+
+        std::vector<uint64_t> ticks(2 * recorded.stages.size());
+        auto result = device_.getQueryPoolResults(query_pool_, first_query(slot), static_cast<uint32_t>(ticks.size()),
+            ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+        if (result != vk::Result::eSuccess) return;
+
+        for (size_t i = 0; i < recorded.stages.size(); ++i) {
+            uint64_t elapsed = (ticks[2 * i + 1] - ticks[2 * i]) & recorded.valid_mask;
+            series_[recorded.stages[i]].add(elapsed * timestamp_period_ * 1e-6);
+        }
+    }
+
+    void collect_all() {
+        for (uint32_t slot = 0; slot < slots_.size(); ++slot)
+            collect(slot);
+    }
+
+    // in the order the stages were first recorded
+    std::vector<stage_stats> stats() const {
+        std::vector<stage_stats> result;
+
+        for (const auto& series : series_) {
+            if (series.samples.empty()) continue;
+
+            std::vector<double> sorted = series.samples;
+            std::sort(sorted.begin(), sorted.end());
+
+            double sum = 0.0;
+            for (double sample : sorted)
+                sum += sample;
+
+            size_t p99_index = std::min(sorted.size() - 1, static_cast<size_t>(std::ceil(0.99 * sorted.size())) - 1);
+
+            result.push_back({ series.name, sorted.size(), sorted.front(), sum / sorted.size(), sorted[p99_index] });
+        }
+
+        return result;
+    }
+
+    void print(std::ostream& out) const {
+        for (const auto& stage : stats()) {
+            out << "    " << stage.name << ": min " << stage.min_ms << " ms, mean " << stage.mean_ms << " ms, p99 " << stage.p99_ms
+                << " ms (" << stage.samples << " samples)" << std::endl;
+        }
+    }
+
+    void write_csv(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file) throw std::runtime_error("cannot write " + path);
+
+        file << "stage,samples,min_ms,mean_ms,p99_ms\n";
+        for (const auto& stage : stats())
+            file << stage.name << "," << stage.samples << "," << stage.min_ms << "," << stage.mean_ms << "," << stage.p99_ms << "\n";
+    }
+
+    // mean per stage, short enough for the window title
+    std::string summary() const {
+        std::ostringstream out;
+        out.precision(3);
+
+        for (const auto& stage : stats())
+            out << (out.tellp() > 0 ? " " : "") << stage.name << " " << stage.mean_ms;
+
+        if (out.tellp() > 0)
+            out << " ms";
+
+        return out.str();
+    }
+
+private:
+    struct slot_state {
+        std::vector<size_t> stages; // series index of every begin/end pair, in recording order
+        uint64_t valid_mask = 0;
+        bool open = false;
+        bool pending = false;
+    };
+
+    struct stage_series {
+        std::string name;
+        std::vector<double> samples; // ring of the last window_size durations in ms
+        size_t next = 0;
+
+        void add(double sample) {
+            if (samples.size() < window_size)
+                samples.push_back(sample);
+            else
+                samples[next] = sample;
+
+            next = (next + 1) % window_size;
+        }
+    };
+
+    bool recording_enabled() const {
+        return enabled() && current_slot_ < slots_.size() && slots_[current_slot_].valid_mask;
+    }
+
+    uint32_t first_query(uint32_t slot) const {
+        return slot * 2 * max_stages_per_slot;
+    }
+
+    size_t stage_index(const char* name) {
+        for (size_t i = 0; i < series_.size(); ++i)
+            if (series_[i].name == name) return i;
+
+        series_.push_back({ name });
+        return series_.size() - 1;
+    }
+
+    vk::Device device_;
+    vk::QueryPool query_pool_;
+    float timestamp_period_ = 1.f;
+
+    std::vector<slot_state> slots_;
+    std::vector<stage_series> series_;
+    uint32_t current_slot_ = 0;
+};
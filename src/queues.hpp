@@ -1,42 +1,64 @@
-#pragma once
-#include "config.hpp"
-
-struct QueueFamilyIndices {
-	int graphics_family = -1;
-	int present_family = -1;
-	int compute_family = -1;
-
-	bool is_complete() const {
-		return 
-			graphics_family != -1
-			&&
-			present_family != -1
-			&&
-			compute_family != -1;
-	}
-};
-
-QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice &device, vk::SurfaceKHR &surface) {
-	QueueFamilyIndices indices;
-	
-	auto queue_family_properties = device.getQueueFamilyProperties();
-	
-	int i = 0;
-	for (const auto& property : queue_family_properties) {
-
-		if (property.queueFlags & vk::QueueFlagBits::eGraphics)
-			indices.graphics_family = i;
-		
-		if (bool present_support = device.getSurfaceSupportKHR(i, surface))
-			indices.present_family = i;
-
-		if (property.queueFlags & vk::QueueFlagBits::eCompute)
-			indices.compute_family = i;
-
-		if (indices.is_complete()) break;
-
-		++i;
-	}
-
-	return indices;
-}
\ No newline at end of file
+#pragma once
+#include "config.hpp"
+
+struct QueueFamilyIndices {
+	int graphics_family = -1;
+	int present_family = -1;
+	int compute_family = -1;
+	int transfer_family = -1; // uploads; the compute family when there is no transfer-only one
+
+	bool is_complete() const {
+		return 
+			graphics_family != -1
+			&&
+			present_family != -1
+			&&
+			compute_family != -1;
+	}
+};
+
+// graphics and present prefer a single family, and the graphics family has to do compute as well, since the cull and splat
+// passes are dispatched from the graphics command buffers; compute prefers a family without graphics, which usually maps to a separate
+// hardware queue that can run next to rendering, and falls back to a family that also does graphics; transfer prefers a
+// family with neither, usually the copy engine, and falls back to the compute family
+QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice &device, vk::SurfaceKHR &surface) {
+	QueueFamilyIndices indices;
+	
+	auto queue_family_properties = device.getQueueFamilyProperties();
+
+	int shared_compute_family = -1;
+	
+	for (int i = 0; i < static_cast<int>(queue_family_properties.size()); ++i) {
+		const auto flags = queue_family_properties[i].queueFlags;
+
+		if ((flags & vk::QueueFlagBits::eGraphics) && (flags & vk::QueueFlagBits::eCompute) && indices.graphics_family == -1)
+			indices.graphics_family = i;
+		
+		// without a surface (headless) nothing is presented, the graphics family stands in for the present family
+		bool presentable = !surface || device.getSurfaceSupportKHR(i, surface);
+
+		if (presentable && (indices.present_family == -1 || i == indices.graphics_family))
+			indices.present_family = i;
+
+		if (flags & vk::QueueFlagBits::eCompute) {
+			if (!(flags & vk::QueueFlagBits::eGraphics)) {
+				if (indices.compute_family == -1)
+					indices.compute_family = i;
+			}
+			else if (shared_compute_family == -1 || i == indices.graphics_family) {
+				shared_compute_family = i;
+			}
+		}
+		else if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics) && indices.transfer_family == -1) {
+			indices.transfer_family = i;
+		}
+	}
+
+	if (indices.compute_family == -1)
+		indices.compute_family = shared_compute_family;
+
+	if (indices.transfer_family == -1)
+		indices.transfer_family = indices.compute_family;
+
+	return indices;
+}
@@ -1,203 +1,1171 @@
-#pragma once
-#include "device_context.hpp"
-#include "fluid.hpp"
-
-class render_system {
-public:
-    void run() {
-        record_compute_command_buffer();
-        
-        while (!glfwWindowShouldClose(GPU_.window_)) {
-            glfwPollEvents();
-         
-            run_simulation();
-            draw_frame();
-        }
-    }
-
-private:
-    void run_simulation() {
-        vk::SubmitInfo compute_submit_info{};
-        compute_submit_info.commandBufferCount = 1;
-        compute_submit_info.pCommandBuffers = &GPU_.compute_command_buffer_;
-
-        GPU_.compute_queue_.submit(compute_submit_info);
-    }
-
-    void draw_frame() {
-        GPU_.logical_device_.waitForFences(GPU_.in_flight_fences[current_frame_], true, UINT64_MAX);
-        GPU_.logical_device_.resetFences(GPU_.in_flight_fences[current_frame_]);
-
-        auto acquire_image_result = GPU_.logical_device_.acquireNextImageKHR(GPU_.swapchain_handle, UINT64_MAX, GPU_.image_available_semaphores[current_frame_]);
-        auto image_index = acquire_image_result.value;
-
-        GPU_.graphics_command_buffers_[current_frame_].reset();
-        record_graphics_command_buffer(GPU_.graphics_command_buffers_[current_frame_], image_index);
-
-        vk::Semaphore wait_semaphores[] = {
-            GPU_.image_available_semaphores[current_frame_]
-        };
-        vk::PipelineStageFlags wait_stages[] = {
-            vk::PipelineStageFlagBits::eColorAttachmentOutput
-        };
-
-        vk::SubmitInfo submit_info{};
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores = wait_semaphores;
-        submit_info.pWaitDstStageMask = wait_stages;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &GPU_.graphics_command_buffers_[current_frame_];
-
-        vk::Semaphore signal_semaphores[] = {
-            GPU_.render_finished_semaphores[current_frame_]
-        };
-        submit_info.pSignalSemaphores = signal_semaphores;
-        submit_info.signalSemaphoreCount = 1;
-
-        GPU_.graphics_queue_.submit(submit_info, GPU_.in_flight_fences[current_frame_]);
-
-        vk::PresentInfoKHR present_info{};
-        present_info.waitSemaphoreCount = 1;
-        present_info.pWaitSemaphores = signal_semaphores;
-        present_info.pSwapchains = &GPU_.swapchain_handle;
-        present_info.swapchainCount = 1;
-        present_info.pImageIndices = &image_index;
-
-        auto present_result = GPU_.present_queue_.presentKHR(present_info);
-
-        ++current_frame_ %= MAX_FRAMES_IN_FLIGHT;
-    }
-
-private:
-    void record_graphics_command_buffer(vk::CommandBuffer& commandBuffer, uint32_t image_index) {
-        vk::CommandBufferBeginInfo begin_info{};
-
-        commandBuffer.begin(begin_info);
-
-        vk::RenderPassBeginInfo render_pass_info{};
-        render_pass_info.renderPass = GPU_.renderpass_;
-        render_pass_info.framebuffer = GPU_.swapchain_frame_buffers_[image_index];
-        render_pass_info.renderArea.offset = vk::Offset2D(0, 0);
-        render_pass_info.renderArea.extent = GPU_.swapchain_extent_;
-
-        vk::ClearValue clear_values[2];
-        clear_values[0].color = vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 1.0f };
-        clear_values[1].depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
-
-        render_pass_info.clearValueCount = sizeof(clear_values) / sizeof(clear_values[0]);
-        render_pass_info.pClearValues = clear_values;
-
-        commandBuffer.beginRenderPass(render_pass_info, vk::SubpassContents::eInline);
-        
-        vk::Viewport viewport{};
-        viewport.height = static_cast<float>(GPU_.swapchain_extent_.height);
-        viewport.width = static_cast<float>(GPU_.swapchain_extent_.width);
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        commandBuffer.setViewport(0, viewport);
-
-        vk::Rect2D scissor{};
-        scissor.offset = vk::Offset2D{ 0, 0 };
-        scissor.extent = GPU_.swapchain_extent_;
-
-        commandBuffer.setScissor(0, scissor);
-
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, GPU_.graphics_pipeline_);
-
-        commandBuffer.bindVertexBuffers(0, { GPU_.packed_particles_buffer_ }, { 0 });
-
-        commandBuffer.draw(static_cast<uint32_t>(particles_.size()), 1, 0, 0);
-
-        commandBuffer.endRenderPass();
-        commandBuffer.end();
-    }
-
-    void record_graphics_command_buffers() {
-        for (int i = 0; i < GPU_.graphics_command_buffers_.size(); ++i) {
-            vk::CommandBufferBeginInfo begin_info{};
-            begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-
-            GPU_.graphics_command_buffers_[i].begin(begin_info);
-
-            vk::ClearValue clear_value{};
-            clear_value.color = vk::ClearColorValue({ 1.0f, 1.0f, 1.0f, 1.0f });
-
-            vk::RenderPassBeginInfo render_pass_begin_info{};
-
-            render_pass_begin_info.renderPass = GPU_.renderpass_;
-            render_pass_begin_info.framebuffer = GPU_.swapchain_frame_buffers_[i];
-            render_pass_begin_info.clearValueCount = 1;
-            render_pass_begin_info.pClearValues = &clear_value;
-            render_pass_begin_info.renderArea.offset = vk::Offset2D{ 0, 0 };
-            render_pass_begin_info.renderArea.extent = vk::Extent2D{ GPU_.window_width_, GPU_.window_height_ };
-
-            GPU_.graphics_command_buffers_[i].beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
-
-            vk::Viewport viewport{};
-            viewport.x = 0;
-            viewport.y = 0;
-            viewport.width = static_cast<float>(GPU_.window_width_);
-            viewport.height = static_cast<float>(GPU_.window_height_);
-            viewport.minDepth = 0;
-            viewport.maxDepth = 1;
-
-            vk::Rect2D scissor{};
-            scissor.offset = vk::Offset2D{ 0, 0 };
-            scissor.extent = vk::Extent2D{ GPU_.window_width_, GPU_.window_height_ };
-
-            GPU_.graphics_command_buffers_[i].setViewport(0, { viewport });
-            GPU_.graphics_command_buffers_[i].setScissor(0, { scissor });
-
-            GPU_.graphics_command_buffers_[i].bindPipeline(vk::PipelineBindPoint::eGraphics, GPU_.graphics_pipeline_);
-
-            vk::DeviceSize offsets = 0;
-            GPU_.graphics_command_buffers_[i].bindVertexBuffers(0, { GPU_.packed_particles_buffer_ }, offsets);
-
-            GPU_.graphics_command_buffers_[i].draw(particles_.size(), 1, 0, 0);
-
-            GPU_.graphics_command_buffers_[i].endRenderPass();
-
-            GPU_.graphics_command_buffers_[i].end();
-        }
-    }
-
-    void record_compute_command_buffer() {
-        vk::CommandBufferBeginInfo begin_info{};
-        begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-
-        GPU_.compute_command_buffer_.begin(begin_info);
-
-        const int workgroup_size = 128;
-        const int groupcount = (particles_.size() / workgroup_size) + 1;
-
-        uint32_t count = (particles_.size() + workgroup_size - 1) / workgroup_size;
-
-        GPU_.compute_command_buffer_.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GPU_.compute_pipeline_layout_, 0, { GPU_.compute_descriptor_set_ }, {});
-
-        GPU_.compute_command_buffer_.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.density_pipeline_);
-        GPU_.compute_command_buffer_.dispatch(count, 1, 1);
-        GPU_.compute_command_buffer_.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), {}, {}, {});
-
-
-        GPU_.compute_command_buffer_.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.force_pipeline_);
-        GPU_.compute_command_buffer_.dispatch(count, 1, 1);
-        GPU_.compute_command_buffer_.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), {}, {}, {});
-
-
-        GPU_.compute_command_buffer_.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.position_pipeline_);
-        GPU_.compute_command_buffer_.dispatch(count, 1, 1);
-        GPU_.compute_command_buffer_.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), {}, {}, {});
-
-        GPU_.compute_command_buffer_.end();
-    }
-
-private:
-    uint32_t current_frame_;
-
-	std::vector<glm::vec2> particles_ = fluid::generate_initial_positions(4992); // should be a multiple of 64
-	
-    device_context GPU_{ particles_ };
-};
+#pragma once
+#include "device_context.hpp"
+#include "fluid.hpp"
+#include "trajectory_writer.hpp"
+
+#include <random>
+
+class render_system {
+public:
+    render_system(const simulation_settings& settings) : settings_(settings), steps_per_frame_(settings.steps_per_frame) {
+        // a restored run continues the step count of the checkpoint, so frames and checkpoints keep their spacing
+        simulation_step_ = GPU_.restored_step_;
+        next_trajectory_step_ = simulation_step_;
+        next_checkpoint_step_ = simulation_step_ + settings_.checkpoint_interval;
+
+        if (!settings_.trajectory_path.empty())
+            open_trajectory();
+    }
+
+    void run() {
+        record_compute_command_buffers(settings_.neighbor_search);
+        record_reorder_command_buffers();
+
+        // +/- double or halve the simulation steps submitted per rendered frame, the arrow keys pan a tenth of the view,
+        // R switches between the point pipeline and the compute rasterizer
+        glfwSetWindowUserPointer(GPU_.window_, this);
+        glfwSetKeyCallback(GPU_.window_, [](GLFWwindow* window, int key, int, int action, int) {
+            if (action != GLFW_PRESS && action != GLFW_REPEAT) return;
+
+            auto app = static_cast<render_system*>(glfwGetWindowUserPointer(window));
+            const float pan = 0.2f / app->zoom_;
+
+            if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD)
+                app->steps_per_frame_ = std::min(app->steps_per_frame_ * 2, max_steps_per_frame);
+            else if (key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT)
+                app->steps_per_frame_ = std::max(app->steps_per_frame_ / 2, 1u);
+            else if (key == GLFW_KEY_LEFT)
+                app->view_center_.x -= pan;
+            else if (key == GLFW_KEY_RIGHT)
+                app->view_center_.x += pan;
+            else if (key == GLFW_KEY_UP)
+                app->view_center_.y -= pan;
+            else if (key == GLFW_KEY_DOWN)
+                app->view_center_.y += pan;
+            else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+                // the other renderer may still be compiling in the background; if it failed, keep drawing with this one
+                // rather than letting the exception unwind through GLFW
+                const auto next = app->renderer_ == render_mode::points ? render_mode::splat : render_mode::points;
+
+                try {
+                    app->GPU_.wait_for_renderer_pipelines(next);
+                    app->renderer_ = next;
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "cannot switch to the " << to_string(next) << " renderer: " << e.what() << std::endl;
+                }
+            }
+        });
+
+        // the scroll wheel zooms about the view center
+        glfwSetScrollCallback(GPU_.window_, [](GLFWwindow* window, double, double offset) {
+            auto app = static_cast<render_system*>(glfwGetWindowUserPointer(window));
+            app->zoom_ = std::clamp(app->zoom_ * std::pow(1.25f, static_cast<float>(offset)), 0.05f, 1000.f);
+        });
+
+        stats_window_start_ = std::chrono::high_resolution_clock::now();
+        
+        while (!glfwWindowShouldClose(GPU_.window_)) {
+            glfwPollEvents();
+         
+            run_simulation(steps_per_frame_, true);
+            draw_frame();
+
+            update_frame_stats();
+        }
+
+        capture_last_trajectory_frame();
+
+        GPU_.logical_device_.waitIdle();
+        write_last_checkpoint();
+        report_particle_count_stats();
+        report_neighbor_list_stats();
+        report_time_step_stats();
+        report_async_compute_stats();
+        report_profile();
+        report_trajectory_stats();
+        GPU_.staging_.print_stats(std::cout);
+        GPU_.allocator_.print_usage(std::cout);
+    }
+
+    // steps until settings_.headless_steps or settings_.headless_time is reached, in batches as large as the GPU can take
+    // without the host checking in; nothing is drawn unless an offscreen image was asked for
+    void run_headless() {
+        record_compute_command_buffers(settings_.neighbor_search);
+        record_reorder_command_buffers();
+
+        uint64_t target_steps = settings_.headless_steps;
+
+        // a fixed dt turns the simulated time into a step count up front, an adaptive one is checked after every batch
+        if (settings_.headless_time > 0.f && !settings_.adaptive_time_step)
+            target_steps = std::max<uint64_t>(target_steps, static_cast<uint64_t>(std::ceil(settings_.headless_time / settings_.params.dt)));
+
+        auto time_reached = [&] {
+            return settings_.adaptive_time_step && settings_.headless_time > 0.f && GPU_.time_step_state_->simulated_time >= settings_.headless_time;
+        };
+
+        if (target_steps == 0 && !(settings_.adaptive_time_step && settings_.headless_time > 0.f))
+            throw std::runtime_error("--headless needs --steps or --simulated-time");
+
+        auto start = std::chrono::high_resolution_clock::now();
+        uint64_t steps = 0;
+
+        while (target_steps ? steps < target_steps : !time_reached()) {
+            uint32_t batch = target_steps ? static_cast<uint32_t>(std::min<uint64_t>(headless_batch_steps, target_steps - steps)) : headless_batch_steps;
+
+            // batches end where trajectory frames or checkpoints are due, they are taken at the start of the next one
+            auto end_batch_at = [&](uint64_t due_step, uint32_t interval) {
+                uint64_t until_due = due_step > simulation_step_ ? due_step - simulation_step_ : interval;
+                batch = static_cast<uint32_t>(std::min<uint64_t>(batch, until_due));
+            };
+
+            if (trajectory_)
+                end_batch_at(next_trajectory_step_, settings_.trajectory_interval);
+            if (settings_.checkpoint_interval)
+                end_batch_at(next_checkpoint_step_, settings_.checkpoint_interval);
+
+            run_simulation(batch);
+            steps += batch;
+
+            if (!target_steps)
+                GPU_.logical_device_.waitForFences(GPU_.compute_fence_, true, UINT64_MAX);
+        }
+
+        GPU_.logical_device_.waitForFences(GPU_.compute_fence_, true, UINT64_MAX);
+        capture_last_trajectory_frame();
+
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        double simulated_time = settings_.adaptive_time_step ? GPU_.time_step_state_->simulated_time : steps * settings_.params.dt;
+
+        std::cout << "headless: " << steps << " steps, " << simulated_time << " s simulated in " << elapsed.count() << " s, "
+            << steps / elapsed.count() << " steps/s, " << steps * GPU_.particle_count_->alive / elapsed.count() << " particle-steps/s" << std::endl;
+
+        if (!settings_.offscreen_image.empty())
+            render_offscreen(settings_.offscreen_image);
+
+        GPU_.logical_device_.waitIdle();
+        write_last_checkpoint();
+        report_particle_count_stats();
+        report_neighbor_list_stats();
+        report_time_step_stats();
+        report_profile();
+        report_trajectory_stats();
+        GPU_.staging_.print_stats(std::cout);
+        GPU_.allocator_.print_usage(std::cout);
+    }
+
+    // average ms per simulation step over back-to-back steps, without rendering
+    double measure_step_time(uint32_t steps) {
+        record_compute_command_buffers(settings_.neighbor_search);
+        record_reorder_command_buffers();
+
+        // warm up so pipeline and allocation costs stay out of the measurement
+        GPU_.submit_compute_and_wait();
+        GPU_.upload_particles(particles_);
+
+        return time_steps(steps);
+    }
+
+    // average ms per frame of `renderer` drawing the uploaded state into the offscreen image, without simulating; every
+    // frame is recorded, submitted and waited for on its own, which both renderers pay alike
+    double measure_frame_time(render_mode renderer, uint32_t frames) {
+        GPU_.wait_for_renderer_pipelines(renderer);
+        renderer_ = renderer;
+
+        // warm up so pipeline and first-use costs stay out of the measurement
+        draw_offscreen_frame();
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint32_t frame = 0; frame < frames; ++frame)
+            draw_offscreen_frame();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        return elapsed.count() / frames;
+    }
+
+    // runs `steps` steps from the initial state and returns where they left the particles
+    particle_snapshot simulate(uint32_t steps) {
+        record_compute_command_buffers(settings_.neighbor_search);
+        record_reorder_command_buffers();
+
+        GPU_.upload_particles(particles_);
+        simulation_step_ = 0;
+
+        run_simulation(steps);
+        GPU_.compute_queue_.waitIdle();
+
+        auto snapshot = GPU_.download_particles();
+
+        GPU_.upload_particles(particles_);
+        simulation_step_ = 0;
+
+        return snapshot;
+    }
+
+    // the layout the device actually runs, compact storage falls back to fp32 without 16-bit storage support
+    bool compact_storage() const {
+        return GPU_.settings_.compact_storage;
+    }
+
+    // per slot, free ones included
+    double bytes_per_particle() const {
+        return static_cast<double>(GPU_.packed_buffer_size) / settings_.capacity();
+    }
+
+    // runs one step through the brute-force loops and the configured neighbor search from the same initial state and compares the results
+    bool validate_neighbor_search() {
+        // both searches sum the same neighbours in a different order, so the results differ by rounding alone: a few fp32
+        // ulps, or a few fp16 ulps (about 5e-4 relative each) once density, pressure and velocity are stored compact
+        const float tolerance = compact_storage() ? 4e-3f : 1e-4f;
+
+        if (settings_.neighbor_search == neighbor_search_mode::brute_force)
+            throw std::runtime_error("--validate-grid needs a grid neighbor search");
+
+        GPU_.upload_particles(particles_);
+        record_compute_command_buffers(neighbor_search_mode::brute_force);
+        GPU_.submit_compute_and_wait();
+        auto reference = GPU_.download_particles();
+
+        GPU_.upload_particles(particles_);
+        record_compute_command_buffers(settings_.neighbor_search);
+        GPU_.submit_compute_and_wait();
+        auto candidate = GPU_.download_particles();
+
+        GPU_.upload_particles(particles_);
+
+        auto relative_error = [](float expected, float actual) {
+            return std::abs(expected - actual) / std::max(std::abs(expected), 1e-6f);
+        };
+
+        float max_density_error = 0.f;
+        float max_force_error = 0.f;
+        float max_position_error = 0.f;
+
+        if (candidate.position.size() != reference.position.size()) {
+            std::cout << to_string(settings_.neighbor_search) << " validation: " << candidate.position.size() << " particles left vs "
+                << reference.position.size() << " -> FAILED" << std::endl;
+            return false;
+        }
+
+        for (size_t i = 0; i < reference.position.size(); ++i) {
+            max_density_error = std::max(max_density_error, relative_error(reference.density[i], candidate.density[i]));
+            max_force_error = std::max(max_force_error, relative_error(glm::length(reference.force[i]), glm::length(candidate.force[i])));
+            max_position_error = std::max(max_position_error, glm::length(reference.position[i] - candidate.position[i]));
+        }
+
+        bool passed = max_density_error < tolerance && max_force_error < tolerance && max_position_error < tolerance;
+
+        std::cout << to_string(settings_.neighbor_search) << " validation (" << particles_.size() << " particles): "
+            << "density " << max_density_error << ", force " << max_force_error << ", position " << max_position_error
+            << (passed ? " -> PASSED" : " -> FAILED") << std::endl;
+
+        return passed;
+    }
+
+    // times settings_.benchmark_steps back-to-back simulation steps without rendering
+    void benchmark_neighbor_search() {
+        double ms_per_step = measure_step_time(settings_.benchmark_steps);
+
+        std::cout << to_string(settings_.neighbor_search) << ", "
+            << to_string(settings_.distribution) << ", "
+            << particles_.size() << " particles, "
+            << GPU_.grid_buffer_size << " grid bytes, "
+            << ms_per_step << " ms/step" << std::endl;
+
+        report_neighbor_list_stats();
+        report_time_step_stats();
+        report_profile();
+
+        if (settings_.reorder_interval) {
+            // the generated particles are stored row by row, already in spatial order, and a benchmark is far too short
+            // for them to scatter; both runs start from the same particles in a fixed random storage order instead, so
+            // the comparison shows the locality a reorder restores and not just what its passes cost
+            auto shuffled = particles_;
+            std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(reorder_benchmark_seed));
+
+            GPU_.upload_particles(shuffled);
+            double reordered_ms_per_step = time_steps(settings_.benchmark_steps);
+            uint32_t reorders = reorder_count_;
+
+            auto reorder_interval = settings_.reorder_interval;
+            settings_.reorder_interval = 0;
+            GPU_.upload_particles(shuffled);
+            double never_reordered_ms_per_step = time_steps(settings_.benchmark_steps);
+            settings_.reorder_interval = reorder_interval;
+
+            std::cout << "    Morton reorder every " << reorder_interval << " steps (" << reorders << " reorders), from the particles shuffled with seed "
+                << reorder_benchmark_seed << ": " << reordered_ms_per_step << " ms/step vs " << never_reordered_ms_per_step << " ms/step never reordering, "
+                << 100.0 * (never_reordered_ms_per_step - reordered_ms_per_step) / never_reordered_ms_per_step << "% gain" << std::endl;
+        }
+    }
+
+private:
+    // replays the pre-recorded steps `steps` times in one submission; every step ends in a barrier, so the copies chain
+    // correctly, and the fence keeps at most one batch in flight so the step rate follows what the GPU completes.
+    // With `displayed`, the batch is synchronized with draw_frame on the GPU through the two timelines: the frame drawn
+    // last keeps reading the state it was given while the first step writes the other half of the ping-pong pair, only
+    // the steps that write that state again (and Morton reorders, which permute it in place) wait until the frame
+    // released it. On a dedicated compute family the batch runs next to the frame instead of between frames.
+    void run_simulation(uint32_t steps, bool displayed = false) {
+        GPU_.logical_device_.waitForFences(GPU_.compute_fence_, true, UINT64_MAX);
+        GPU_.logical_device_.resetFences(GPU_.compute_fence_);
+
+        // the previous batch has completed, its passes can be read without waiting
+        for (uint32_t slot = 0; slot < GPU_.graphics_profile_slot; ++slot)
+            GPU_.profiler_.collect(slot);
+
+        if (trajectory_ && simulation_step_ >= next_trajectory_step_)
+            capture_trajectory_frame();
+
+        if (settings_.checkpoint_interval && simulation_step_ >= next_checkpoint_step_)
+            write_checkpoint();
+
+        std::vector<vk::CommandBuffer> command_buffers;
+        size_t overlapping_command_buffers = 0;
+
+        for (uint32_t step = 0; step < steps; ++step) {
+            if (settings_.reorder_interval && simulation_step_ % settings_.reorder_interval == 0) {
+                command_buffers.push_back(GPU_.reorder_command_buffers_[GPU_.current_state_]);
+                GPU_.profiler_.submitted(GPU_.reorder_profile_slot + GPU_.current_state_);
+                ++reorder_count_;
+            }
+
+            command_buffers.push_back(GPU_.compute_command_buffers_[GPU_.current_state_]);
+            GPU_.profiler_.submitted(GPU_.compute_profile_slot + GPU_.current_state_);
+            GPU_.current_state_ ^= 1;
+
+            if (step == 0 && command_buffers.size() == 1)
+                overlapping_command_buffers = 1;
+
+            ++simulation_step_;
+        }
+
+        stats_steps_ += steps;
+
+        if (!displayed) {
+            vk::SubmitInfo compute_submit_info{};
+            compute_submit_info.commandBufferCount = static_cast<uint32_t>(command_buffers.size());
+            compute_submit_info.pCommandBuffers = command_buffers.data();
+
+            GPU_.compute_queue_.submit(compute_submit_info, GPU_.compute_fence_);
+            return;
+        }
+
+        // the fence above guarantees the previous batch, and with it its timestamps, has completed
+        if (GPU_.overlap_measurable_) {
+            if (frame_count_ > 0)
+                last_batch_ticks_ = GPU_.read_overlap_queries(4 * ((current_frame_ + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT));
+
+            command_buffers.insert(command_buffers.begin(), GPU_.batch_begin_command_buffers_[current_frame_]);
+            command_buffers.push_back(GPU_.batch_end_command_buffers_[current_frame_]);
+            ++overlapping_command_buffers;
+        }
+
+        // frame n - 2 read the half the first step writes, frame n - 1 the half the rest of the batch writes
+        const uint64_t released_values[2] = { frame_count_ > 0 ? frame_count_ - 1 : 0, frame_count_ };
+        const uint64_t finished_value = frame_count_ + 1;
+        const vk::PipelineStageFlags released_stage = vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer;
+
+        vk::TimelineSemaphoreSubmitInfo timeline_infos[2]{};
+        vk::SubmitInfo submit_infos[2]{};
+
+        for (int i = 0; i < 2; ++i) {
+            timeline_infos[i].waitSemaphoreValueCount = 1;
+            timeline_infos[i].pWaitSemaphoreValues = &released_values[i];
+
+            submit_infos[i].pNext = &timeline_infos[i];
+            submit_infos[i].waitSemaphoreCount = 1;
+            submit_infos[i].pWaitSemaphores = &GPU_.render_timeline_;
+            submit_infos[i].pWaitDstStageMask = &released_stage;
+        }
+
+        submit_infos[0].commandBufferCount = static_cast<uint32_t>(overlapping_command_buffers);
+        submit_infos[0].pCommandBuffers = command_buffers.data();
+
+        timeline_infos[1].signalSemaphoreValueCount = 1;
+        timeline_infos[1].pSignalSemaphoreValues = &finished_value;
+
+        submit_infos[1].commandBufferCount = static_cast<uint32_t>(command_buffers.size() - overlapping_command_buffers);
+        submit_infos[1].pCommandBuffers = command_buffers.data() + overlapping_command_buffers;
+        submit_infos[1].signalSemaphoreCount = 1;
+        submit_infos[1].pSignalSemaphores = &GPU_.simulation_timeline_;
+
+        GPU_.compute_queue_.submit(submit_infos, GPU_.compute_fence_);
+    }
+
+    // batch n runs while frame n - 1 draws, so once frame n - 2 is known complete, batch n - 1 and frame n - 2 are compared
+    void accumulate_overlap() {
+        if (!GPU_.overlap_measurable_ || frame_count_ < 2)
+            return;
+
+        auto frame_ticks = GPU_.read_overlap_queries(4 * current_frame_ + 2);
+
+        if (last_batch_ticks_[1] <= last_batch_ticks_[0] || frame_ticks[1] <= frame_ticks[0])
+            return;
+
+        uint64_t overlap_begin = std::max(last_batch_ticks_[0], frame_ticks[0]);
+        uint64_t overlap_end = std::min(last_batch_ticks_[1], frame_ticks[1]);
+
+        overlap_ticks_ += overlap_end > overlap_begin ? overlap_end - overlap_begin : 0;
+        batch_ticks_ += last_batch_ticks_[1] - last_batch_ticks_[0];
+    }
+
+    double overlap_percentage() const {
+        return batch_ticks_ ? 100.0 * overlap_ticks_ / batch_ticks_ : 0.0;
+    }
+
+    // draws the current state into the offscreen image and waits until it is there
+    void draw_offscreen_frame() {
+        GPU_.logical_device_.waitForFences(GPU_.in_flight_fences[0], true, UINT64_MAX);
+        GPU_.logical_device_.resetFences(GPU_.in_flight_fences[0]);
+
+        current_frame_ = 0;
+        GPU_.graphics_command_buffers_[0].reset();
+        record_graphics_command_buffer(GPU_.graphics_command_buffers_[0], 0);
+
+        vk::SubmitInfo submit_info{};
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &GPU_.graphics_command_buffers_[0];
+
+        GPU_.graphics_queue_.submit(submit_info, GPU_.in_flight_fences[0]);
+        GPU_.logical_device_.waitForFences(GPU_.in_flight_fences[0], true, UINT64_MAX);
+    }
+
+    // one draw of the current state into the offscreen image, written as a binary PPM
+    void render_offscreen(const std::string& path) {
+        GPU_.compute_queue_.waitIdle();
+
+        draw_offscreen_frame();
+
+        auto pixels = GPU_.download_offscreen_image();
+        const auto extent = GPU_.swapchain_extent_;
+
+        std::ofstream image(path, std::ios::binary);
+        if (!image) throw std::runtime_error("cannot write " + path);
+
+        image << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+
+        for (size_t pixel = 0; pixel < pixels.size(); pixel += 4)
+            image.write(reinterpret_cast<const char*>(&pixels[pixel]), 3);
+
+        std::cout << "final state drawn to " << path << std::endl;
+    }
+
+    // simulated steps per second independent of the frame rate, shown in the window title once a second
+    void update_frame_stats() {
+        ++stats_frames_;
+
+        auto now = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = now - stats_window_start_;
+
+        if (elapsed.count() < 1.0) return;
+
+        std::ostringstream title;
+
+        // like dt below, the live count is read while steps may be in flight
+        if (settings_.dynamic_particle_count())
+            title << GPU_.particle_count_->alive << " / " << settings_.capacity() << " particles | ";
+        else
+            title << particles_.size() << " particles | ";
+
+        title << to_string(renderer_) << " | "
+            << steps_per_frame_ << " steps/frame | "
+            << static_cast<uint64_t>(stats_steps_ / elapsed.count()) << " steps/s | "
+            << static_cast<uint64_t>(stats_frames_ / elapsed.count()) << " fps | "
+            << GPU_.allocator_.used_bytes() / 1048576 << " MB GPU memory";
+
+        // read while steps may be in flight, good enough for a running average
+        if (settings_.adaptive_time_step)
+            title << " | dt " << GPU_.time_step_state_->dt;
+
+        if (batch_ticks_)
+            title << " | " << static_cast<int>(overlap_percentage()) << "% overlap";
+
+        if (settings_.profile_output == "title")
+            title << " | " << GPU_.profiler_.summary();
+
+        glfwSetWindowTitle(GPU_.window_, title.str().c_str());
+
+        stats_window_start_ = now;
+        stats_steps_ = 0;
+        stats_frames_ = 0;
+    }
+
+    // runs the steps from the uploaded initial state and restores it afterwards
+    double time_steps(uint32_t steps) {
+        simulation_step_ = 0;
+        reorder_count_ = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        run_simulation(steps);
+
+        GPU_.compute_queue_.waitIdle();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        GPU_.upload_particles(particles_);
+        simulation_step_ = 0;
+
+        return elapsed.count() / steps;
+    }
+
+    void draw_frame() {
+        GPU_.logical_device_.waitForFences(GPU_.in_flight_fences[current_frame_], true, UINT64_MAX);
+        GPU_.logical_device_.resetFences(GPU_.in_flight_fences[current_frame_]);
+
+        accumulate_overlap();
+        GPU_.profiler_.collect(GPU_.graphics_profile_slot + current_frame_);
+
+        auto acquire_image_result = GPU_.logical_device_.acquireNextImageKHR(GPU_.swapchain_handle, UINT64_MAX, GPU_.image_available_semaphores[current_frame_]);
+        auto image_index = acquire_image_result.value;
+
+        GPU_.graphics_command_buffers_[current_frame_].reset();
+        record_graphics_command_buffer(GPU_.graphics_command_buffers_[current_frame_], image_index);
+
+        vk::Semaphore wait_semaphores[] = {
+            GPU_.image_available_semaphores[current_frame_],
+            GPU_.simulation_timeline_
+        };
+        vk::PipelineStageFlags wait_stages[] = {
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eComputeShader // the cull pass reads the state first, the draw follows it through a barrier
+        };
+
+        // binary semaphores ignore their entry in the value arrays
+        const uint64_t wait_values[] = { 0, frame_count_ + 1 };
+        const uint64_t signal_values[] = { 0, frame_count_ + 1 };
+
+        vk::TimelineSemaphoreSubmitInfo timeline_info{};
+        timeline_info.waitSemaphoreValueCount = 2;
+        timeline_info.pWaitSemaphoreValues = wait_values;
+        timeline_info.signalSemaphoreValueCount = 2;
+        timeline_info.pSignalSemaphoreValues = signal_values;
+
+        vk::SubmitInfo submit_info{};
+        submit_info.pNext = &timeline_info;
+        submit_info.waitSemaphoreCount = 2;
+        submit_info.pWaitSemaphores = wait_semaphores;
+        submit_info.pWaitDstStageMask = wait_stages;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &GPU_.graphics_command_buffers_[current_frame_];
+
+        vk::Semaphore signal_semaphores[] = {
+            GPU_.render_finished_semaphores[current_frame_],
+            GPU_.render_timeline_
+        };
+        submit_info.pSignalSemaphores = signal_semaphores;
+        submit_info.signalSemaphoreCount = 2;
+
+        GPU_.graphics_queue_.submit(submit_info, GPU_.in_flight_fences[current_frame_]);
+        GPU_.profiler_.submitted(GPU_.graphics_profile_slot + current_frame_);
+
+        ++frame_count_;
+
+        vk::PresentInfoKHR present_info{};
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = signal_semaphores;
+        present_info.pSwapchains = &GPU_.swapchain_handle;
+        present_info.swapchainCount = 1;
+        present_info.pImageIndices = &image_index;
+
+        auto present_result = GPU_.present_queue_.presentKHR(present_info);
+
+        ++current_frame_ %= MAX_FRAMES_IN_FLIGHT;
+    }
+
+private:
+    void record_graphics_command_buffer(vk::CommandBuffer& commandBuffer, uint32_t image_index) {
+        vk::CommandBufferBeginInfo begin_info{};
+
+        commandBuffer.begin(begin_info);
+
+        vk::RenderPassBeginInfo render_pass_info{};
+        render_pass_info.renderPass = GPU_.renderpass_;
+        render_pass_info.framebuffer = GPU_.swapchain_frame_buffers_[image_index];
+        render_pass_info.renderArea.offset = vk::Offset2D(0, 0);
+        render_pass_info.renderArea.extent = GPU_.swapchain_extent_;
+
+        vk::ClearValue clear_values[2];
+        clear_values[0].color = vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 1.0f };
+        clear_values[1].depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
+
+        render_pass_info.clearValueCount = sizeof(clear_values) / sizeof(clear_values[0]);
+        render_pass_info.pClearValues = clear_values;
+
+        if (GPU_.overlap_measurable_) {
+            commandBuffer.resetQueryPool(GPU_.overlap_query_pool_, 4 * current_frame_ + 2, 2);
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, GPU_.overlap_query_pool_, 4 * current_frame_ + 2);
+        }
+
+        GPU_.profiler_.begin_recording(commandBuffer, GPU_.graphics_profile_slot + current_frame_);
+
+        // the state of the last submitted step, draw_frame waits until it is written
+        const auto view = view_constants(GPU_.current_state_);
+
+        if (renderer_ == render_mode::splat)
+            record_splat(commandBuffer, view);
+        else
+            record_cull(commandBuffer, view);
+
+        GPU_.profiler_.begin(commandBuffer, "render pass");
+
+        commandBuffer.beginRenderPass(render_pass_info, vk::SubpassContents::eInline);
+        
+        vk::Viewport viewport{};
+        viewport.height = static_cast<float>(GPU_.swapchain_extent_.height);
+        viewport.width = static_cast<float>(GPU_.swapchain_extent_.width);
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        commandBuffer.setViewport(0, viewport);
+
+        vk::Rect2D scissor{};
+        scissor.offset = vk::Offset2D{ 0, 0 };
+        scissor.extent = GPU_.swapchain_extent_;
+
+        commandBuffer.setScissor(0, scissor);
+
+        if (renderer_ == render_mode::splat) {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, GPU_.splat_resolve_pipeline_);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, GPU_.splat_resolve_pipeline_layout_, 0, { GPU_.compute_descriptor_sets_[view.drawn_state] }, {});
+            commandBuffer.pushConstants(GPU_.splat_resolve_pipeline_layout_, vk::ShaderStageFlagBits::eFragment, 0, sizeof(view), &view);
+
+            commandBuffer.draw(3, 1, 0, 0);
+        }
+        else {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, GPU_.graphics_pipeline_);
+            commandBuffer.pushConstants(GPU_.graphics_pipeline_layout_, vk::ShaderStageFlagBits::eVertex, 0, sizeof(view), &view);
+
+            // vertex work follows the visible particles, the indices pick them out of the whole position array
+            commandBuffer.bindVertexBuffers(0, { GPU_.packed_particles_buffer_ }, { GPU_.position_offset(GPU_.current_state_) });
+            commandBuffer.bindIndexBuffer(GPU_.cull_buffer_, sizeof(culled_draw_arguments), vk::IndexType::eUint32);
+
+            commandBuffer.drawIndexedIndirect(GPU_.cull_buffer_, 0, 1, sizeof(culled_draw_arguments));
+        }
+
+        commandBuffer.endRenderPass();
+        GPU_.profiler_.end(commandBuffer);
+
+        if (GPU_.overlap_measurable_)
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, GPU_.overlap_query_pool_, 4 * current_frame_ + 3);
+
+        commandBuffer.end();
+    }
+
+    // the view of the window; points grow with the zoom so that a zoomed-in fluid stays closed
+    view_push_constants view_constants(uint32_t state) const {
+        view_push_constants view{};
+        view.center = view_center_;
+        view.scale = glm::vec2(zoom_);
+        view.point_size = std::clamp(point_size * zoom_, 1.f, 63.f);
+        view.drawn_state = state;
+        view.extent = glm::vec2(GPU_.swapchain_extent_.width, GPU_.swapchain_extent_.height);
+        view.bins_x = GPU_.cull_bins_x_;
+        view.bins_y = GPU_.cull_bins_y_;
+        view.bin_size = device_context::cull_bin_size;
+        view.bin_limit = settings_.cull_bin_limit;
+
+        return view;
+    }
+
+    // frustum culls the drawn half and, with a bin limit, drops the particles past it in every screen bin, leaving the
+    // indices of the rest and the arguments of the indexed indirect draw in the cull buffer. The frame before may still
+    // be drawing from that buffer, so the pass starts by waiting for its draw.
+    void record_cull(vk::CommandBuffer command_buffer, const view_push_constants& view) {
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(), {}, {}, {});
+
+        const culled_draw_arguments no_indices{ 0, 1, 0, 0, 0 };
+        command_buffer.updateBuffer(GPU_.cull_buffer_, 0, sizeof(no_indices), &no_indices);
+
+        if (view.bin_limit)
+            command_buffer.fillBuffer(GPU_.cull_buffer_, GPU_.cull_bins_ssbo_offset, GPU_.cull_bins_ssbo_size, 0);
+
+        vk::MemoryBarrier clear_barrier{};
+        clear_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        clear_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), clear_barrier, {}, {});
+
+        const uint32_t workgroup_size = settings_.params.workgroup_size;
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.particle_cull_pipeline_);
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GPU_.cull_pipeline_layout_, 0, { GPU_.compute_descriptor_sets_[view.drawn_state] }, {});
+        command_buffer.pushConstants(GPU_.cull_pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(view), &view);
+
+        // over every slot, the live count of the half is only known on the GPU
+        GPU_.profiler_.begin(command_buffer, "cull");
+        command_buffer.dispatch((settings_.capacity() + workgroup_size - 1) / workgroup_size, 1, 1);
+        GPU_.profiler_.end(command_buffer);
+
+        vk::MemoryBarrier draw_barrier{};
+        draw_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        draw_barrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+            vk::DependencyFlags(), draw_barrier, {}, {});
+    }
+
+    // the compute rasterizer: clears the per-pixel counts, splats every particle of the drawn half into them and hands
+    // them to the fullscreen resolve. The frame before may still be resolving the same counts, so the clear waits for it.
+    void record_splat(vk::CommandBuffer command_buffer, const view_push_constants& view) {
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {}, {});
+
+        command_buffer.fillBuffer(GPU_.splat_buffer_, 0, GPU_.splat_ssbo_size, 0);
+
+        vk::MemoryBarrier clear_barrier{};
+        clear_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        clear_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), clear_barrier, {}, {});
+
+        const uint32_t workgroup_size = settings_.params.workgroup_size;
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.particle_splat_pipeline_);
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GPU_.cull_pipeline_layout_, 0, { GPU_.compute_descriptor_sets_[view.drawn_state] }, {});
+        command_buffer.pushConstants(GPU_.cull_pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(view), &view);
+
+        GPU_.profiler_.begin(command_buffer, "splat");
+        command_buffer.dispatch((settings_.capacity() + workgroup_size - 1) / workgroup_size, 1, 1);
+        GPU_.profiler_.end(command_buffer);
+
+        vk::MemoryBarrier splat_barrier{};
+        splat_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        splat_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), splat_barrier, {}, {});
+    }
+
+    // one command buffer per ping-pong state, each reads that state and writes the other
+    void record_compute_command_buffers(neighbor_search_mode neighbor_search) {
+        // only the configured neighbor search is guaranteed to be compiled when the window opens
+        if (neighbor_search != settings_.neighbor_search)
+            GPU_.wait_for_pipelines();
+
+        for (uint32_t state = 0; state < 2; ++state)
+            record_compute_command_buffer(GPU_.compute_command_buffers_[state], state, neighbor_search);
+    }
+
+    void record_compute_command_buffer(vk::CommandBuffer command_buffer, uint32_t state, neighbor_search_mode neighbor_search) {
+        vk::CommandBufferBeginInfo begin_info{};
+        begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+
+        command_buffer.begin(begin_info);
+        GPU_.profiler_.begin_recording(command_buffer, GPU_.compute_profile_slot + state);
+
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GPU_.compute_pipeline_layout_, 0, { GPU_.compute_descriptor_sets_[state] }, {});
+
+        // the tunables are captured at record time, re-record after changing them
+        auto push_constants = settings_.params.push_constants();
+        command_buffer.pushConstants(GPU_.compute_pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(push_constants), &push_constants);
+
+        if (neighbor_search == neighbor_search_mode::uniform_grid) {
+            record_grid_build(command_buffer, GPU_.grid_count_pipeline_);
+
+            record_particle_pass(command_buffer, "density", GPU_.density_grid_pipeline_);
+            record_particle_pass(command_buffer, "force", GPU_.force_grid_pipeline_);
+        }
+        else if (neighbor_search == neighbor_search_mode::hashed_grid) {
+            record_grid_build(command_buffer, GPU_.hash_count_pipeline_);
+
+            record_particle_pass(command_buffer, "density", GPU_.density_hash_pipeline_);
+            record_particle_pass(command_buffer, "force", GPU_.force_hash_pipeline_);
+        }
+        else if (neighbor_search == neighbor_search_mode::verlet_list) {
+            record_neighbor_list_update(command_buffer);
+
+            record_particle_pass(command_buffer, "density", GPU_.density_list_pipeline_);
+            record_particle_pass(command_buffer, "force", GPU_.force_list_pipeline_);
+        }
+        else {
+            record_particle_pass(command_buffer, "density", GPU_.density_pipeline_);
+            record_particle_pass(command_buffer, "force", GPU_.force_pipeline_);
+        }
+
+        if (settings_.adaptive_time_step)
+            record_time_step_update(command_buffer);
+
+        record_particle_pass(command_buffer, "position", GPU_.position_pipeline_);
+
+        if (settings_.dynamic_particle_count())
+            record_particle_count_update(command_buffer);
+
+        command_buffer.end();
+    }
+
+    // sorts the particles along a Z-order curve and permutes all five arrays, so that neighbours sit close in memory again
+    void record_reorder_command_buffers() {
+        // never submitted, and their pipelines may still be compiling in the background
+        if (!settings_.reorder_interval) return;
+
+        for (uint32_t state = 0; state < 2; ++state)
+            record_reorder_command_buffer(GPU_.reorder_command_buffers_[state], state);
+    }
+
+    void record_reorder_command_buffer(vk::CommandBuffer command_buffer, uint32_t state) {
+        vk::CommandBufferBeginInfo begin_info{};
+        begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+
+        command_buffer.begin(begin_info);
+        GPU_.profiler_.begin_recording(command_buffer, GPU_.reorder_profile_slot + state);
+
+        const uint32_t workgroup_size = settings_.params.workgroup_size;
+
+        uint32_t key_count = (GPU_.morton_key_count_ + workgroup_size - 1) / workgroup_size;
+
+        // the permutation reads from a snapshot, so it can write the live arrays in place
+        vk::MemoryBarrier snapshot_barrier{};
+        snapshot_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        snapshot_barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), snapshot_barrier, {}, {});
+
+        vk::BufferCopy snapshot_region{};
+        snapshot_region.srcOffset = 0;
+        snapshot_region.dstOffset = 0;
+        snapshot_region.size = GPU_.packed_buffer_size;
+
+        GPU_.profiler_.begin(command_buffer, "reorder snapshot");
+        command_buffer.copyBuffer(GPU_.packed_particles_buffer_, GPU_.reorder_buffer_, snapshot_region);
+        GPU_.profiler_.end(command_buffer);
+
+        vk::MemoryBarrier copy_barrier{};
+        copy_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        copy_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), copy_barrier, {}, {});
+
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GPU_.reorder_pipeline_layout_, 0, { GPU_.compute_descriptor_sets_[state], GPU_.reorder_source_descriptor_sets_[state] }, {});
+
+        const glm::vec2 bounding_box = settings_.params.bounding_box;
+        command_buffer.pushConstants(GPU_.reorder_pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(uint32_t), sizeof(bounding_box), &bounding_box);
+
+        record_pass(command_buffer, "morton keys", GPU_.morton_keys_pipeline_, key_count);
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.bitonic_sort_pipeline_);
+        GPU_.profiler_.begin(command_buffer, "bitonic sort");
+
+        for (uint32_t block_size = 2; block_size <= GPU_.morton_key_count_; block_size <<= 1) {
+            for (uint32_t compare_distance = block_size >> 1; compare_distance > 0; compare_distance >>= 1) {
+                uint32_t stage[] = { block_size, compare_distance };
+
+                command_buffer.pushConstants(GPU_.reorder_pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(stage), stage);
+                command_buffer.dispatch(key_count, 1, 1);
+                compute_barrier(command_buffer);
+            }
+        }
+
+        GPU_.profiler_.end(command_buffer);
+
+        record_particle_pass(command_buffer, "reorder", GPU_.reorder_pipeline_);
+
+        // the neighbor lists hold the old indices
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {}, {});
+
+        uint32_t force_rebuild = 1;
+        command_buffer.updateBuffer(GPU_.neighbor_list_status_buffer_, offsetof(neighbor_list_status, force_rebuild), sizeof(force_rebuild), &force_rebuild);
+
+        vk::MemoryBarrier rebuild_barrier{};
+        rebuild_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        rebuild_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), rebuild_barrier, {}, {});
+
+        command_buffer.end();
+    }
+
+    // counting sort of the particles into cells of size h (or their hash buckets): count -> exclusive scan -> scatter
+    void record_grid_build(vk::CommandBuffer& command_buffer, vk::Pipeline count_pipeline) {
+        // the previous step may still be reading the cell counts
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {}, {});
+
+        command_buffer.fillBuffer(GPU_.grid_buffer_, GPU_.cell_count_ssbo_offset, GPU_.cell_count_ssbo_size, 0);
+
+        vk::MemoryBarrier clear_barrier{};
+        clear_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        clear_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), clear_barrier, {}, {});
+
+        record_particle_pass(command_buffer, "grid count", count_pipeline);
+        record_pass(command_buffer, "grid scan", GPU_.grid_scan_pipeline_, 1);
+        record_particle_pass(command_buffer, "grid scatter", GPU_.grid_scatter_pipeline_);
+    }
+
+    // measures how far the particles moved since the last build and rebuilds the lists through indirect
+    // dispatches that are zero-sized while the skin still covers that distance, all without a CPU round-trip
+    void record_neighbor_list_update(vk::CommandBuffer& command_buffer) {
+        record_particle_pass(command_buffer, "list displacement", GPU_.neighbor_list_displacement_pipeline_);
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.neighbor_list_decide_pipeline_);
+        GPU_.profiler_.begin(command_buffer, "list decide");
+        command_buffer.dispatch(1, 1, 1);
+        GPU_.profiler_.end(command_buffer);
+
+        vk::MemoryBarrier indirect_barrier{};
+        indirect_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        indirect_barrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), indirect_barrier, {}, {});
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {}, {});
+
+        command_buffer.fillBuffer(GPU_.grid_buffer_, GPU_.cell_count_ssbo_offset, GPU_.cell_count_ssbo_size, 0);
+
+        vk::MemoryBarrier clear_barrier{};
+        clear_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        clear_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), clear_barrier, {}, {});
+
+        const vk::DeviceSize rebuild_dispatch_offset = offsetof(neighbor_list_status, rebuild_dispatch);
+        const vk::DeviceSize scan_dispatch_offset = offsetof(neighbor_list_status, scan_dispatch);
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.grid_count_pipeline_);
+        GPU_.profiler_.begin(command_buffer, "list count");
+        command_buffer.dispatchIndirect(GPU_.neighbor_list_status_buffer_, rebuild_dispatch_offset);
+        GPU_.profiler_.end(command_buffer);
+        compute_barrier(command_buffer);
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.grid_scan_pipeline_);
+        GPU_.profiler_.begin(command_buffer, "list scan");
+        command_buffer.dispatchIndirect(GPU_.neighbor_list_status_buffer_, scan_dispatch_offset);
+        GPU_.profiler_.end(command_buffer);
+        compute_barrier(command_buffer);
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.grid_scatter_pipeline_);
+        GPU_.profiler_.begin(command_buffer, "list scatter");
+        command_buffer.dispatchIndirect(GPU_.neighbor_list_status_buffer_, rebuild_dispatch_offset);
+        GPU_.profiler_.end(command_buffer);
+        compute_barrier(command_buffer);
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, GPU_.neighbor_list_build_pipeline_);
+        GPU_.profiler_.begin(command_buffer, "list build");
+        command_buffer.dispatchIndirect(GPU_.neighbor_list_status_buffer_, rebuild_dispatch_offset);
+        GPU_.profiler_.end(command_buffer);
+        compute_barrier(command_buffer);
+    }
+
+    // reduces the largest speed and acceleration after the force pass and derives the dt the position pass integrates with
+    void record_time_step_update(vk::CommandBuffer command_buffer) {
+        record_particle_pass(command_buffer, "time step reduce", GPU_.time_step_reduce_pipeline_);
+        record_pass(command_buffer, "time step update", GPU_.time_step_update_pipeline_, 1);
+    }
+
+    // after the position pass: the sinks flag what they caught, the survivors behind the gaps move into them, the emitters
+    // append their rows and the count update turns the new live count into the indirect arguments of the next step and of
+    // the draw of the half just written
+    void record_particle_count_update(vk::CommandBuffer command_buffer) {
+        record_particle_pass(command_buffer, "sink", GPU_.particle_sink_pipeline_);
+        record_pass(command_buffer, "compact scan", GPU_.compact_scan_pipeline_, 1);
+        record_particle_pass(command_buffer, "compact move", GPU_.compact_move_pipeline_);
+        record_pass(command_buffer, "emit", GPU_.particle_emit_pipeline_, 1);
+        record_pass(command_buffer, "count update", GPU_.particle_count_update_pipeline_, 1);
+
+        vk::MemoryBarrier indirect_barrier{};
+        indirect_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        indirect_barrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), indirect_barrier, {}, {});
+    }
+
+    void open_trajectory() {
+        trajectory_header header{};
+        std::memcpy(header.magic, "SPHTRAJ", 8);
+        header.version = trajectory_writer::version;
+        header.flags = (GPU_.settings_.compact_storage ? trajectory_compact_fields : 0) | (settings_.trajectory_compression ? trajectory_compressed : 0);
+        header.particle_count = settings_.capacity();
+        header.keyframe_interval = trajectory_writer::keyframe_interval;
+        header.position_bytes = static_cast<uint32_t>(GPU_.position_ssbo_size);
+        header.velocity_bytes = static_cast<uint32_t>(GPU_.velocity_ssbo_size);
+        header.density_bytes = static_cast<uint32_t>(GPU_.density_ssbo_size);
+        header.pressure_bytes = static_cast<uint32_t>(GPU_.pressure_ssbo_size);
+        header.particle_radius = settings_.params.radius;
+        header.dt = settings_.params.dt;
+
+        std::vector<const char*> slots;
+        for (const auto& slot : GPU_.readback_slots_)
+            slots.push_back(slot.mapped);
+
+        trajectory_ = std::make_unique<trajectory_writer>(settings_.trajectory_path, header, std::move(slots), GPU_.readback_frame_size,
+            [this](uint32_t slot) { GPU_.wait_for_readback(slot); });
+    }
+
+    // copies the state the last submitted step leaves behind into a free readback slot; with every slot still waiting
+    // for the writer the frame is dropped rather than waited for
+    void capture_trajectory_frame() {
+        last_trajectory_step_ = simulation_step_;
+        next_trajectory_step_ = simulation_step_ + settings_.trajectory_interval;
+
+        auto slot = trajectory_->acquire_slot();
+        if (!slot) return;
+
+        GPU_.submit_readback(*slot);
+
+        // an adaptive dt leaves the simulated time to the copy of the time step state
+        std::optional<float> simulated_time;
+        if (!settings_.adaptive_time_step)
+            simulated_time = static_cast<float>(simulation_step_ * settings_.params.dt);
+
+        trajectory_->push(*slot, simulation_step_, simulated_time);
+    }
+
+    // frames are copied at the start of a batch, so the state a run ends in is copied here
+    void capture_last_trajectory_frame() {
+        if (trajectory_ && last_trajectory_step_ != simulation_step_)
+            capture_trajectory_frame();
+    }
+
+    // the compute fence has signalled, so the packed buffer holds the state of simulation_step_; a displayed frame may
+    // still be reading it, which the copy does not disturb
+    void write_checkpoint() {
+        last_checkpoint_step_ = simulation_step_;
+        next_checkpoint_step_ = simulation_step_ + settings_.checkpoint_interval;
+
+        GPU_.save_checkpoint(settings_.checkpoint_path, simulation_step_);
+    }
+
+    void write_last_checkpoint() {
+        if (!settings_.checkpoint_path.empty() && last_checkpoint_step_ != simulation_step_)
+            write_checkpoint();
+    }
+
+    void report_trajectory_stats() {
+        if (!trajectory_) return;
+
+        trajectory_->flush();
+        trajectory_->print_stats(std::cout);
+    }
+
+    void report_time_step_stats() {
+        if (!settings_.adaptive_time_step) return;
+
+        const auto& state = *GPU_.time_step_state_;
+
+        if (state.step_count == 0 || state.simulated_time <= 0.f) return;
+
+        double average_dt = static_cast<double>(state.simulated_time) / state.step_count;
+        double fixed_steps_per_second = 1.0 / settings_.params.dt;
+
+        std::cout << "    adaptive dt: " << state.step_count << " steps over " << state.simulated_time << " s simulated, average dt " << average_dt
+            << " (fixed " << settings_.params.dt << "), " << fixed_steps_per_second - 1.0 / average_dt << " steps saved per simulated second" << std::endl;
+    }
+
+    void report_async_compute_stats() {
+        if (!batch_ticks_) return;
+
+        std::cout << "    async compute: " << (GPU_.compute_queue_family_index_ != GPU_.graphics_queue_family_index_ ? "dedicated" : "shared")
+            << " compute family, " << overlap_percentage() << "% of " << batch_ticks_ * GPU_.timestamp_period_ * 1e-6 << " ms of batches overlapped rendering" << std::endl;
+    }
+
+    // min, mean and p99 of every timed pass over the last gpu_profiler::window_size samples
+    void report_profile() {
+        if (!GPU_.profiler_.enabled()) return;
+
+        GPU_.profiler_.collect_all();
+
+        if (settings_.profile_output == "stdout" || settings_.profile_output == "title") {
+            std::cout << "    GPU passes:" << std::endl;
+            GPU_.profiler_.print(std::cout);
+        }
+        else {
+            GPU_.profiler_.write_csv(settings_.profile_output);
+            std::cout << "    GPU pass timings written to " << settings_.profile_output << std::endl;
+        }
+    }
+
+    void report_particle_count_stats() {
+        if (!settings_.dynamic_particle_count()) return;
+
+        const auto& count = *GPU_.particle_count_;
+
+        std::cout << "    particles: " << count.alive << " alive of " << count.capacity << " slots, " << count.total_emitted << " emitted, "
+            << count.total_removed << " removed, " << count.dropped << " not emitted for lack of slots" << std::endl;
+    }
+
+    void report_neighbor_list_stats() {
+        if (settings_.neighbor_search != neighbor_search_mode::verlet_list) return;
+
+        const auto& status = *GPU_.neighbor_list_status_;
+
+        std::cout << "    neighbor lists: " << status.rebuild_count << " rebuilds in " << status.step_count << " steps";
+        if (status.rebuild_count)
+            std::cout << " (every " << static_cast<double>(status.step_count) / status.rebuild_count << " steps)";
+        std::cout << ", " << status.overflow_count << " overflowing lists, skin " << status.skin << std::endl;
+    }
+
+    // binds, dispatches and times one pass; the barrier makes its writes visible to the next one
+    void record_pass(vk::CommandBuffer command_buffer, const char* name, vk::Pipeline pipeline, uint32_t group_count) {
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+
+        GPU_.profiler_.begin(command_buffer, name);
+        command_buffer.dispatch(group_count, 1, 1);
+        GPU_.profiler_.end(command_buffer);
+
+        compute_barrier(command_buffer);
+    }
+
+    // a pass over the live particles, its group count is taken from the particle count buffer when it runs
+    void record_particle_pass(vk::CommandBuffer command_buffer, const char* name, vk::Pipeline pipeline) {
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+
+        GPU_.profiler_.begin(command_buffer, name);
+        command_buffer.dispatchIndirect(GPU_.particle_count_buffer_, offsetof(particle_count_state, dispatch));
+        GPU_.profiler_.end(command_buffer);
+
+        compute_barrier(command_buffer);
+    }
+
+    void compute_barrier(vk::CommandBuffer& command_buffer) {
+        vk::MemoryBarrier memory_barrier{};
+        memory_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        memory_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), memory_barrier, {}, {});
+    }
+
+private:
+    simulation_settings settings_;
+
+    uint32_t current_frame_ = 0;
+    uint64_t frame_count_ = 0; // frames submitted, the values the two timelines count in
+
+    std::array<uint64_t, 2> last_batch_ticks_{}; // begin and end of the last completed displayed batch
+    uint64_t overlap_ticks_ = 0; // batch time spent while the previous frame was drawing
+    uint64_t batch_ticks_ = 0;
+
+    uint64_t simulation_step_ = 0;
+    uint32_t reorder_count_ = 0;
+
+    uint64_t next_trajectory_step_ = 0;
+    uint64_t last_trajectory_step_ = UINT64_MAX;
+
+    uint64_t next_checkpoint_step_ = 0;
+    uint64_t last_checkpoint_step_ = UINT64_MAX;
+
+    static constexpr uint32_t max_steps_per_frame = 1024;
+    static constexpr uint32_t headless_batch_steps = 256; // steps per submission without a frame to pace them
+    static constexpr uint32_t reorder_benchmark_seed = 1; // of the storage order the reorder benchmark starts from
+    uint32_t steps_per_frame_;
+
+    static constexpr float point_size = 5.f; // pixels at zoom 1
+    glm::vec2 view_center_ = settings_.view_center;
+    float zoom_ = settings_.zoom;
+    render_mode renderer_ = settings_.renderer;
+
+    std::chrono::high_resolution_clock::time_point stats_window_start_;
+    uint64_t stats_steps_ = 0;
+    uint64_t stats_frames_ = 0;
+
+	std::vector<glm::vec2> particles_ = fluid::generate_positions(settings_);
+	
+    device_context GPU_{ particles_, settings_ };
+
+    // after GPU_, so the writer has finished with the readback slots before they are destroyed
+    std::unique_ptr<trajectory_writer> trajectory_;
+};
@@ -0,0 +1,377 @@
+#pragma once
+#include "config.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class neighbor_search_mode {
+	brute_force,
+	uniform_grid,
+	hashed_grid,
+	verlet_list // per-particle lists built from the uniform grid, reused until the particles moved half the skin
+};
+
+enum class particle_distribution {
+	block, // one dense block resting on the floor
+	sparse // small clusters scattered over the domain
+};
+
+enum class render_mode {
+	points, // a point list through the fixed-function rasterizer, after the cull pass
+	splat // a compute shader splats the particles into a per-pixel count buffer, a fullscreen pass resolves it
+};
+
+// mirrors the simulation_parameters push constant block of the compute shaders
+struct simulation_push_constants {
+	float m;
+	float resting_density;
+	float stiffness;
+	float viscosity;
+	glm::vec2 gravity;
+	float dt;
+	float collision_damping;
+	glm::vec2 bounding_box;
+	float poly6;
+	float spiky_gradient;
+	float viscosity_laplacian;
+};
+
+static_assert(sizeof(simulation_push_constants) == 52, "must match the std430 push constant block");
+
+// slots of the emitter and sink tables in the particle_count_state block of the shaders
+constexpr uint32_t max_emitters = 4;
+constexpr uint32_t max_sinks = 4;
+
+// spawns a row of particles across `velocity`, centered on `origin`, whenever the last row has moved a particle diameter away
+struct emitter_region {
+	glm::vec2 origin;
+	glm::vec2 velocity;
+	float width;
+};
+
+// removes every particle that ends a step inside the box
+struct sink_region {
+	glm::vec2 lower;
+	glm::vec2 upper;
+};
+
+struct sim_params {
+	// structural values, baked into the compute pipelines as specialization constants
+	uint32_t workgroup_size = 128;
+	float radius = 0.005f; // particle radius, the kernel radius is h = 4 * radius
+
+	// per-step tunables, recorded as push constants
+	float mass = 0.02f;
+	float resting_density = 1000.f;
+	float stiffness = 2000.f;
+	float viscosity = 3000.f;
+	glm::vec2 gravity = { 0.f, 9806.65f };
+	float dt = 0.0001f;
+	float collision_damping = 0.3f;
+	glm::vec2 bounding_box = { 1.f, 1.f }; // half extents of the box around the origin
+
+	float kernel_radius() const {
+		return 4 * radius;
+	}
+
+	// cells of size h per side of the dense grid, which spans the bounding box; positions on the far wall are clamped into the last cell
+	uint32_t grid_resolution() const {
+		return static_cast<uint32_t>(std::ceil(2 * std::max(bounding_box.x, bounding_box.y) / kernel_radius() - 1e-3f));
+	}
+
+	// the kernel normalization factors are computed once here instead of per neighbour pair on the GPU
+	simulation_push_constants push_constants() const {
+		const float pi = 3.1415927410125732421875f;
+		const float h = kernel_radius();
+
+		simulation_push_constants constants{};
+		constants.m = mass;
+		constants.resting_density = resting_density;
+		constants.stiffness = stiffness;
+		constants.viscosity = viscosity;
+		constants.gravity = gravity;
+		constants.dt = dt;
+		constants.collision_damping = collision_damping;
+		constants.bounding_box = bounding_box;
+		constants.poly6 = 315.f / (64.f * pi * std::pow(h, 9.f));
+		constants.spiky_gradient = -45.f / (pi * std::pow(h, 6.f));
+		constants.viscosity_laplacian = 45.f / (pi * std::pow(h, 6.f));
+
+		return constants;
+	}
+};
+
+struct simulation_settings {
+	uint32_t particle_count = 4992; // particles of the initial distribution
+	uint32_t particle_capacity = 0; // slots every particle array is sized for, emitters fill them up; 0 leaves no room beyond particle_count
+	std::vector<emitter_region> emitters;
+	std::vector<sink_region> sinks;
+	sim_params params;
+	particle_distribution distribution = particle_distribution::block;
+
+	neighbor_search_mode neighbor_search = neighbor_search_mode::uniform_grid;
+	bool compact_storage = false; // fp16 velocity, density and pressure; needs 16-bit storage buffer support
+	bool tiled_all_pairs = false; // stage j-particles in workgroup shared memory in the brute-force kernels
+	uint32_t hash_table_capacity = 0; // buckets of the hashed grid, 0 picks the next power of two >= 2 * capacity()
+
+	float neighbor_list_skin = 0.005f; // added to h when the verlet lists are built
+	uint32_t max_neighbors = 64; // longer lists are truncated and counted as overflows
+
+	uint32_t steps_per_frame = 1; // simulation steps submitted per rendered frame, +/- change it at runtime
+
+	float zoom = 1.f; // the initial view, the scroll wheel zooms and the arrow keys pan at runtime
+	glm::vec2 view_center = { 0.f, 0.f };
+	uint32_t cull_bin_limit = 0; // particles drawn per point-sized screen bin, 0 draws every visible one
+	render_mode renderer = render_mode::points; // R switches it at runtime
+
+	uint32_t reorder_interval = 0; // steps between Morton reorders of the particle arrays, 0 never reorders
+
+	bool adaptive_time_step = false; // derive dt from the fastest particle every step, params.dt only seeds the first step
+	float dt_min = 0.00002f;
+	float dt_max = 0.0005f;
+	float cfl_number = 0.4f; // fraction of h a particle may travel per step
+	float force_factor = 0.25f; // same bound for the distance gained from the acceleration alone
+
+	bool headless = false; // no window, surface or swapchain; runs headless_steps or headless_time as fast as possible
+	uint32_t headless_steps = 0;
+	float headless_time = 0.f; // simulated seconds
+	std::string offscreen_image; // headless only: draws the final state offscreen and writes it here as a binary PPM
+
+	std::string trajectory_path; // streams position, velocity, density and pressure to this file, empty writes none
+	uint32_t trajectory_interval = 100; // steps between trajectory frames, rounded up to whole batches
+	bool trajectory_compression = false;
+
+	std::string checkpoint_path; // the packed particle buffer is written here at the end of the run, empty writes none
+	uint32_t checkpoint_interval = 0; // steps between checkpoints during the run as well, rounded up to whole batches, 0 only writes the last
+	std::string restore_path; // starts from this checkpoint instead of the initial distribution; fixes particle count and layout
+
+	bool cpu_solver = false; // step on the CPU reference solver instead of the GPU, always headless
+	uint32_t cpu_threads = 0; // 0 uses every hardware thread
+
+	bool validate_neighbor_search = false;
+	uint32_t benchmark_steps = 0;
+	uint32_t crossover_benchmark_steps = 0;
+	uint32_t precision_benchmark_steps = 0;
+	uint32_t cpu_benchmark_steps = 0;
+	uint32_t cpu_validation_steps = 0; // steps the GPU and the CPU solver run from the same state before they are compared
+	uint32_t render_benchmark_frames = 0; // frames each renderer draws per particle count
+
+	std::string shader_directory; // load the .spv files from here instead of the embedded SPIR-V, for shader development
+	std::string pipeline_cache_path = "pipeline_cache.bin"; // loaded at startup when it matches the device, rewritten at shutdown
+
+	std::string profile_output; // GPU timestamps per pass: "stdout", "title" or the path of a CSV file, empty records none
+
+	uint32_t capacity() const {
+		return std::max(particle_capacity, particle_count);
+	}
+
+	// the live count changes on the GPU, the arrays are compacted after every step
+	bool dynamic_particle_count() const {
+		return !emitters.empty() || !sinks.empty();
+	}
+};
+
+inline neighbor_search_mode parse_neighbor_search_mode(std::string_view name) {
+	if (name == "brute-force") return neighbor_search_mode::brute_force;
+	if (name == "uniform-grid") return neighbor_search_mode::uniform_grid;
+	if (name == "hashed-grid") return neighbor_search_mode::hashed_grid;
+	if (name == "verlet-list") return neighbor_search_mode::verlet_list;
+
+	throw std::runtime_error("unknown neighbor search: " + std::string(name));
+}
+
+inline const char* to_string(neighbor_search_mode mode) {
+	switch (mode) {
+		case neighbor_search_mode::brute_force: return "brute-force";
+		case neighbor_search_mode::uniform_grid: return "uniform-grid";
+		case neighbor_search_mode::hashed_grid: return "hashed-grid";
+		case neighbor_search_mode::verlet_list: return "verlet-list";
+	}
+	return "";
+}
+
+inline render_mode parse_render_mode(std::string_view name) {
+	if (name == "points") return render_mode::points;
+	if (name == "splat") return render_mode::splat;
+
+	throw std::runtime_error("unknown renderer: " + std::string(name));
+}
+
+inline const char* to_string(render_mode mode) {
+	switch (mode) {
+		case render_mode::points: return "points";
+		case render_mode::splat: return "splat";
+	}
+	return "";
+}
+
+inline const char* to_string(particle_distribution distribution) {
+	switch (distribution) {
+		case particle_distribution::block: return "block";
+		case particle_distribution::sparse: return "sparse";
+	}
+	return "";
+}
+
+inline simulation_settings parse_command_line(int argc, char** argv) {
+	simulation_settings settings{};
+
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+
+		if (arg == "--particles" && i + 1 < argc)
+			settings.particle_count = std::stoul(argv[++i]);
+		else if (arg == "--capacity" && i + 1 < argc)
+			settings.particle_capacity = std::stoul(argv[++i]);
+		else if (arg == "--emitter" && i + 5 < argc) {
+			emitter_region emitter{};
+			emitter.origin = { std::stof(argv[i + 1]), std::stof(argv[i + 2]) };
+			emitter.velocity = { std::stof(argv[i + 3]), std::stof(argv[i + 4]) };
+			emitter.width = std::stof(argv[i + 5]);
+			settings.emitters.push_back(emitter);
+			i += 5;
+		}
+		else if (arg == "--sink" && i + 4 < argc) {
+			sink_region sink{};
+			sink.lower = { std::stof(argv[i + 1]), std::stof(argv[i + 2]) };
+			sink.upper = { std::stof(argv[i + 3]), std::stof(argv[i + 4]) };
+			settings.sinks.push_back(sink);
+			i += 4;
+		}
+		else if (arg == "--radius" && i + 1 < argc)
+			settings.params.radius = std::stof(argv[++i]);
+		else if (arg == "--workgroup-size" && i + 1 < argc)
+			settings.params.workgroup_size = std::stoul(argv[++i]);
+		else if (arg == "--mass" && i + 1 < argc)
+			settings.params.mass = std::stof(argv[++i]);
+		else if (arg == "--stiffness" && i + 1 < argc)
+			settings.params.stiffness = std::stof(argv[++i]);
+		else if (arg == "--viscosity" && i + 1 < argc)
+			settings.params.viscosity = std::stof(argv[++i]);
+		else if (arg == "--dt" && i + 1 < argc)
+			settings.params.dt = std::stof(argv[++i]);
+		else if (arg == "--sparse")
+			settings.distribution = particle_distribution::sparse;
+		else if (arg == "--neighbor-search" && i + 1 < argc)
+			settings.neighbor_search = parse_neighbor_search_mode(argv[++i]);
+		else if (arg == "--compact")
+			settings.compact_storage = true;
+		else if (arg == "--tiled")
+			settings.tiled_all_pairs = true;
+		else if (arg == "--hash-capacity" && i + 1 < argc)
+			settings.hash_table_capacity = std::stoul(argv[++i]);
+		else if (arg == "--skin" && i + 1 < argc)
+			settings.neighbor_list_skin = std::stof(argv[++i]);
+		else if (arg == "--max-neighbors" && i + 1 < argc)
+			settings.max_neighbors = std::stoul(argv[++i]);
+		else if (arg == "--steps-per-frame" && i + 1 < argc)
+			settings.steps_per_frame = std::max(std::stoul(argv[++i]), 1ul);
+		else if (arg == "--zoom" && i + 1 < argc)
+			settings.zoom = std::stof(argv[++i]);
+		else if (arg == "--view-center" && i + 2 < argc) {
+			settings.view_center.x = std::stof(argv[++i]);
+			settings.view_center.y = std::stof(argv[++i]);
+		}
+		else if (arg == "--cull-bin-limit" && i + 1 < argc)
+			settings.cull_bin_limit = std::stoul(argv[++i]);
+		else if (arg == "--renderer" && i + 1 < argc)
+			settings.renderer = parse_render_mode(argv[++i]);
+		else if (arg == "--reorder-interval" && i + 1 < argc)
+			settings.reorder_interval = std::stoul(argv[++i]);
+		else if (arg == "--adaptive-dt")
+			settings.adaptive_time_step = true;
+		else if (arg == "--dt-min" && i + 1 < argc)
+			settings.dt_min = std::stof(argv[++i]);
+		else if (arg == "--dt-max" && i + 1 < argc)
+			settings.dt_max = std::stof(argv[++i]);
+		else if (arg == "--cfl" && i + 1 < argc)
+			settings.cfl_number = std::stof(argv[++i]);
+		else if (arg == "--headless")
+			settings.headless = true;
+		else if (arg == "--steps" && i + 1 < argc)
+			settings.headless_steps = std::stoul(argv[++i]);
+		else if (arg == "--simulated-time" && i + 1 < argc)
+			settings.headless_time = std::stof(argv[++i]);
+		else if (arg == "--render-to" && i + 1 < argc)
+			settings.offscreen_image = argv[++i];
+		else if (arg == "--trajectory" && i + 1 < argc)
+			settings.trajectory_path = argv[++i];
+		else if (arg == "--trajectory-interval" && i + 1 < argc)
+			settings.trajectory_interval = std::stoul(argv[++i]);
+		else if (arg == "--trajectory-compress")
+			settings.trajectory_compression = true;
+		else if (arg == "--checkpoint" && i + 1 < argc)
+			settings.checkpoint_path = argv[++i];
+		else if (arg == "--checkpoint-interval" && i + 1 < argc)
+			settings.checkpoint_interval = std::stoul(argv[++i]);
+		else if (arg == "--restore" && i + 1 < argc)
+			settings.restore_path = argv[++i];
+		else if (arg == "--cpu") {
+			settings.cpu_solver = true;
+			settings.headless = true;
+		}
+		else if (arg == "--threads" && i + 1 < argc)
+			settings.cpu_threads = std::stoul(argv[++i]);
+		else if (arg == "--validate-grid")
+			settings.validate_neighbor_search = true;
+		else if (arg == "--benchmark" && i + 1 < argc)
+			settings.benchmark_steps = std::stoul(argv[++i]);
+		else if (arg == "--crossover-benchmark" && i + 1 < argc)
+			settings.crossover_benchmark_steps = std::stoul(argv[++i]);
+		else if (arg == "--precision-benchmark" && i + 1 < argc)
+			settings.precision_benchmark_steps = std::stoul(argv[++i]);
+		else if (arg == "--cpu-benchmark" && i + 1 < argc)
+			settings.cpu_benchmark_steps = std::stoul(argv[++i]);
+		else if (arg == "--render-benchmark" && i + 1 < argc)
+			settings.render_benchmark_frames = std::stoul(argv[++i]);
+		else if (arg == "--validate-cpu" && i + 1 < argc)
+			settings.cpu_validation_steps = std::stoul(argv[++i]);
+		else if (arg == "--shader-dir" && i + 1 < argc)
+			settings.shader_directory = argv[++i];
+		else if (arg == "--pipeline-cache" && i + 1 < argc)
+			settings.pipeline_cache_path = argv[++i];
+		else if (arg == "--profile" && i + 1 < argc)
+			settings.profile_output = argv[++i];
+		else
+			throw std::runtime_error("unknown argument: " + std::string(arg));
+	}
+
+	if (settings.params.workgroup_size == 0 || settings.params.radius <= 0.f)
+		throw std::runtime_error("workgroup size and particle radius must be positive");
+
+	if (settings.zoom <= 0.f)
+		throw std::runtime_error("--zoom must be positive");
+
+	if (settings.dt_min <= 0.f || settings.dt_min > settings.dt_max)
+		throw std::runtime_error("time step bounds must satisfy 0 < dt-min <= dt-max");
+
+	if ((settings.headless_steps || settings.headless_time > 0.f || !settings.offscreen_image.empty()) && !settings.headless)
+		throw std::runtime_error("--steps, --simulated-time and --render-to need --headless");
+
+	if (settings.trajectory_interval == 0)
+		throw std::runtime_error("--trajectory-interval must be positive");
+
+	if (settings.checkpoint_interval && settings.checkpoint_path.empty())
+		throw std::runtime_error("--checkpoint-interval needs --checkpoint");
+
+	if (settings.emitters.size() > max_emitters || settings.sinks.size() > max_sinks)
+		throw std::runtime_error("at most " + std::to_string(max_emitters) + " emitters and " + std::to_string(max_sinks) + " sinks");
+
+	for (const auto& emitter : settings.emitters)
+		if (emitter.width <= 0.f || (emitter.velocity.x == 0.f && emitter.velocity.y == 0.f))
+			throw std::runtime_error("--emitter needs a positive width and a nonzero velocity");
+
+	for (const auto& sink : settings.sinks)
+		if (sink.lower.x >= sink.upper.x || sink.lower.y >= sink.upper.y)
+			throw std::runtime_error("--sink needs the lower corner before the upper one");
+
+	if ((settings.cpu_solver || settings.cpu_benchmark_steps || settings.cpu_validation_steps) && settings.dynamic_particle_count())
+		throw std::runtime_error("the CPU solver has a fixed particle count, --emitter and --sink need the GPU");
+
+	if (settings.cpu_solver && (settings.adaptive_time_step || !settings.offscreen_image.empty() || !settings.trajectory_path.empty() ||
+		!settings.checkpoint_path.empty() || !settings.restore_path.empty()))
+		throw std::runtime_error("--cpu supports neither --adaptive-dt, --render-to, --trajectory, --checkpoint nor --restore");
+
+	return settings;
+}
@@ -0,0 +1,27 @@
+#version 460
+
+layout(binding = 20) buffer splat_counts {
+    uint splat_count[]; // written by particle_splat.comp
+};
+
+// the head of the view parameters of particle_splat.comp
+layout(push_constant) uniform view_parameters {
+    vec2 center;
+    vec2 scale;
+    float point_size;
+    uint drawn_state;
+    vec2 extent;
+};
+
+layout(location = 0) out vec4 frag_color;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint count = splat_count[pixel.y * int(extent.x) + pixel.x];
+
+    if (count == 0) discard;
+
+    // the colour of the point pipeline, whitening where eight or more particles pile onto one pixel
+    float density = min(log2(float(count)) / 3.0, 1.0);
+    frag_color = vec4(mix(vec3(0.0, 127.0 / 255.0, 1.0), vec3(1.0), 0.5 * density), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,309 @@
+#pragma once
+#include "config.hpp"
+#include "memory_allocator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// A persistently mapped ring of host visible memory that every upload is staged through. Copies are recorded into a
+// batch and submitted together by flush() on the transfer queue, a dedicated transfer family when the device has one
+// and the compute queue otherwise. A batch is ordered against the compute queue on the GPU alone: an empty submission
+// on the compute queue signals release_timeline_ once the steps submitted before the flush are done with the
+// destination, the copies wait for it and signal transfer_timeline_, and a barrier-only submission on the compute queue
+// waits for that, so every step submitted after the flush sees the upload. The host only waits when the ring is full of
+// copies still in flight. Frames being drawn are not waited for, uploads into a drawn state go between frames.
+class staging_arena {
+public:
+    static constexpr uint32_t command_buffer_count = 4; // batches in flight before recording waits for the oldest
+    static constexpr vk::DeviceSize alignment = 256;
+
+    void create(vk::Device device, memory_allocator& allocator, vk::DeviceSize capacity, vk::Queue transfer_queue, uint32_t transfer_family,
+        vk::Queue compute_queue, vk::CommandPool compute_command_pool) {
+        device_ = device;
+        capacity_ = (capacity + alignment - 1) / alignment * alignment;
+        transfer_queue_ = transfer_queue;
+        compute_queue_ = compute_queue;
+
+        vk::BufferCreateInfo buffer_create_info{};
+        buffer_create_info.size = capacity_;
+        buffer_create_info.usage = vk::BufferUsageFlagBits::eTransferSrc;
+        buffer_create_info.sharingMode = vk::SharingMode::eExclusive;
+
+        buffer_ = device_.createBuffer(buffer_create_info);
+        memory_ = allocator.allocate_buffer(buffer_, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        mapped_ = memory_.mapped;
+
+        vk::CommandPoolCreateInfo pool_create_info{};
+        pool_create_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        pool_create_info.queueFamilyIndex = transfer_family;
+
+        command_pool_ = device_.createCommandPool(pool_create_info);
+
+        vk::CommandBufferAllocateInfo command_buffer_info{};
+        command_buffer_info.commandPool = command_pool_;
+        command_buffer_info.commandBufferCount = command_buffer_count;
+        command_buffer_info.level = vk::CommandBufferLevel::ePrimary;
+
+        command_buffers_ = device_.allocateCommandBuffers(command_buffer_info);
+
+        vk::SemaphoreTypeCreateInfo timeline_info{};
+        timeline_info.semaphoreType = vk::SemaphoreType::eTimeline;
+
+        vk::SemaphoreCreateInfo semaphore_info{};
+        semaphore_info.pNext = &timeline_info;
+
+        release_timeline_ = device_.createSemaphore(semaphore_info);
+        transfer_timeline_ = device_.createSemaphore(semaphore_info);
+
+        // the semaphore wait only holds back its own submission, the barrier carries it over to every later one
+        command_buffer_info.commandPool = compute_command_pool;
+        command_buffer_info.commandBufferCount = 1;
+        acquire_command_buffer_ = device_.allocateCommandBuffers(command_buffer_info).front();
+
+        vk::CommandBufferBeginInfo begin_info{};
+        begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+        acquire_command_buffer_.begin(begin_info);
+
+        vk::MemoryBarrier uploaded{};
+        uploaded.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+        uploaded.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+        acquire_command_buffer_.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags(), uploaded, {}, {});
+
+        acquire_command_buffer_.end();
+    }
+
+    // the device must be idle
+    void destroy(memory_allocator& allocator) {
+        if (!buffer_) return;
+
+        device_.destroyBuffer(buffer_);
+        allocator.free(memory_);
+        device_.destroyCommandPool(command_pool_);
+        device_.destroySemaphore(release_timeline_);
+        device_.destroySemaphore(transfer_timeline_);
+
+        buffer_ = nullptr;
+    }
+
+    // copies `size` bytes from `data` into `destination` at `offset`; large uploads are split into chunks, so the copy of
+    // one chunk runs while the next is written into the ring
+    void write(vk::Buffer destination, vk::DeviceSize offset, const void* data, vk::DeviceSize size) {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto source = static_cast<const char*>(data);
+
+        while (size > 0) {
+            vk::DeviceSize chunk = std::min(size, capacity_ / 4);
+            vk::DeviceSize position = allocate(chunk);
+
+            std::memcpy(mapped_ + position % capacity_, source, chunk);
+            batch().copyBuffer(buffer_, destination, vk::BufferCopy{ position % capacity_, offset, chunk });
+
+            batch_bytes_ += chunk;
+            source += chunk;
+            offset += chunk;
+            size -= chunk;
+
+            if (batch_bytes_ >= capacity_ / 2)
+                flush();
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        staged_ms_ += elapsed.count();
+        staged_bytes_ += source - static_cast<const char*>(data);
+    }
+
+    // fills without staging anything; copies recorded after it in the same batch land on top
+    void fill(vk::Buffer destination, vk::DeviceSize offset, vk::DeviceSize size, uint32_t value) {
+        auto command_buffer = batch();
+        command_buffer.fillBuffer(destination, offset, size, value);
+
+        vk::MemoryBarrier filled{};
+        filled.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        filled.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), filled, {}, {});
+
+        filled_bytes_ += size;
+    }
+
+    // submits the recorded copies and the submissions that order them against the compute queue; returns the value
+    // transfer_timeline() reaches once they have landed
+    uint64_t flush() {
+        if (!recording_) return submitted_;
+
+        command_buffers_[submitted_ % command_buffer_count].end();
+        recording_ = false;
+
+        const uint64_t value = ++submitted_;
+        const vk::PipelineStageFlags transfer_stage = vk::PipelineStageFlagBits::eTransfer;
+        const vk::PipelineStageFlags all_stages = vk::PipelineStageFlagBits::eAllCommands;
+
+        vk::TimelineSemaphoreSubmitInfo release_values{};
+        release_values.signalSemaphoreValueCount = 1;
+        release_values.pSignalSemaphoreValues = &value;
+
+        vk::SubmitInfo release{};
+        release.pNext = &release_values;
+        release.signalSemaphoreCount = 1;
+        release.pSignalSemaphores = &release_timeline_;
+
+        compute_queue_.submit(release);
+
+        vk::TimelineSemaphoreSubmitInfo copy_values{};
+        copy_values.waitSemaphoreValueCount = 1;
+        copy_values.pWaitSemaphoreValues = &value;
+        copy_values.signalSemaphoreValueCount = 1;
+        copy_values.pSignalSemaphoreValues = &value;
+
+        vk::SubmitInfo copy{};
+        copy.pNext = &copy_values;
+        copy.waitSemaphoreCount = 1;
+        copy.pWaitSemaphores = &release_timeline_;
+        copy.pWaitDstStageMask = &transfer_stage;
+        copy.commandBufferCount = 1;
+        copy.pCommandBuffers = &command_buffers_[(value - 1) % command_buffer_count];
+        copy.signalSemaphoreCount = 1;
+        copy.pSignalSemaphores = &transfer_timeline_;
+
+        transfer_queue_.submit(copy);
+
+        vk::TimelineSemaphoreSubmitInfo acquire_values{};
+        acquire_values.waitSemaphoreValueCount = 1;
+        acquire_values.pWaitSemaphoreValues = &value;
+
+        vk::SubmitInfo acquire{};
+        acquire.pNext = &acquire_values;
+        acquire.waitSemaphoreCount = 1;
+        acquire.pWaitSemaphores = &transfer_timeline_;
+        acquire.pWaitDstStageMask = &all_stages;
+        acquire.commandBufferCount = 1;
+        acquire.pCommandBuffers = &acquire_command_buffer_;
+
+        compute_queue_.submit(acquire);
+
+        in_flight_.push_back({ head_, value });
+        batch_bytes_ = 0;
+
+        return value;
+    }
+
+    vk::Semaphore transfer_timeline() const {
+        return transfer_timeline_;
+    }
+
+    void print_stats(std::ostream& out) const {
+        if (submitted_ == 0) return;
+
+        out << "    uploads: " << staged_bytes_ / 1048576.0 << " MB staged at " << staged_gigabytes_per_second() << " GB/s, "
+            << filled_bytes_ / 1048576.0 << " MB filled, " << submitted_ << " batches through a " << capacity_ / 1048576.0 << " MB ring, "
+            << ring_waits_ << " waits for ring space (" << ring_wait_ms_ << " ms)" << std::endl;
+    }
+
+    // host side throughput of write(), waits for ring space included
+    double staged_gigabytes_per_second() const {
+        return staged_ms_ > 0.0 ? staged_bytes_ / (staged_ms_ * 1e6) : 0.0;
+    }
+
+private:
+    struct batch_end {
+        vk::DeviceSize position; // ring position the batch's last chunk ends at
+        uint64_t value;
+    };
+
+    // the command buffer being recorded, begun once the batch that used it last has landed
+    vk::CommandBuffer batch() {
+        auto command_buffer = command_buffers_[submitted_ % command_buffer_count];
+
+        if (!recording_) {
+            if (submitted_ >= command_buffer_count)
+                wait_for(submitted_ + 1 - command_buffer_count);
+
+            command_buffer.reset();
+
+            vk::CommandBufferBeginInfo begin_info{};
+            begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            command_buffer.begin(begin_info);
+
+            recording_ = true;
+        }
+
+        return command_buffer;
+    }
+
+    // positions only grow, a chunk never wraps around the end of the ring
+    vk::DeviceSize allocate(vk::DeviceSize size) {
+        vk::DeviceSize position = (head_ + alignment - 1) / alignment * alignment;
+        if (position % capacity_ + size > capacity_)
+            position = (position / capacity_ + 1) * capacity_;
+
+        while (position + size - tail_ > capacity_) {
+            retire();
+
+            if (position + size - tail_ <= capacity_)
+                break;
+
+            if (in_flight_.empty())
+                flush(); // the batch being recorded holds the rest of the ring
+            else
+                wait_for(in_flight_.front().value);
+        }
+
+        head_ = position + size;
+        return position;
+    }
+
+    void retire() {
+        const uint64_t completed = device_.getSemaphoreCounterValue(transfer_timeline_);
+
+        while (!in_flight_.empty() && in_flight_.front().value <= completed) {
+            tail_ = in_flight_.front().position;
+            in_flight_.pop_front();
+        }
+    }
+
+    void wait_for(uint64_t value) {
+        if (device_.getSemaphoreCounterValue(transfer_timeline_) >= value) return;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        vk::SemaphoreWaitInfo wait_info{};
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &transfer_timeline_;
+        wait_info.pValues = &value;
+
+        (void)device_.waitSemaphores(wait_info, UINT64_MAX);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        ring_wait_ms_ += elapsed.count();
+        ++ring_waits_;
+    }
+
+    vk::Device device_;
+    vk::DeviceSize capacity_ = 0;
+    vk::Queue transfer_queue_;
+    vk::Queue compute_queue_;
+
+    vk::Buffer buffer_;
+    memory_allocation memory_;
+    char* mapped_ = nullptr;
+
+    vk::CommandPool command_pool_;
+    std::vector<vk::CommandBuffer> command_buffers_;
+    vk::CommandBuffer acquire_command_buffer_;
+    vk::Semaphore release_timeline_;
+    vk::Semaphore transfer_timeline_;
+
+    vk::DeviceSize head_ = 0;
+    vk::DeviceSize tail_ = 0;
+    std::deque<batch_end> in_flight_;
+    vk::DeviceSize batch_bytes_ = 0;
+    bool recording_ = false;
+    uint64_t submitted_ = 0;
+
+    uint64_t staged_bytes_ = 0;
+    uint64_t filled_bytes_ = 0;
+    double staged_ms_ = 0.0;
+    uint64_t ring_waits_ = 0;
+    double ring_wait_ms_ = 0.0;
+};
@@ -0,0 +1,305 @@
+#pragma once
+#include "config.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks are plain indices, the graph only records which tasks have to finish before which. It is rebuilt every time the
+// work changes shape, so clear() keeps the allocations.
+class task_graph {
+public:
+    void clear() {
+        for (uint32_t task = 0; task < task_count_; ++task)
+            successors_[task].clear();
+
+        dependency_counts_.clear();
+        task_count_ = 0;
+    }
+
+    uint32_t add_task() {
+        if (successors_.size() == task_count_)
+            successors_.emplace_back();
+
+        dependency_counts_.push_back(0);
+        return task_count_++;
+    }
+
+    // `after` starts only once `before` has finished
+    void add_dependency(uint32_t before, uint32_t after) {
+        successors_[before].push_back(after);
+        ++dependency_counts_[after];
+    }
+
+    uint32_t task_count() const {
+        return task_count_;
+    }
+
+    const std::vector<uint32_t>& successors(uint32_t task) const {
+        return successors_[task];
+    }
+
+    uint32_t dependency_count(uint32_t task) const {
+        return dependency_counts_[task];
+    }
+
+private:
+    std::vector<std::vector<uint32_t>> successors_;
+    std::vector<uint32_t> dependency_counts_;
+    uint32_t task_count_ = 0;
+};
+
+// A pool of threads with one task deque each. A thread pops the newest task of its own deque, which is usually a
+// successor it just released and whose data is still in its cache, and steals the oldest task of another deque when its
+// own runs dry. The calling thread of run() works as thread 0, the others sleep between runs and spin on the deques
+// during one. Busy time is recorded per thread against the wall time of the runs for the utilization report.
+class task_scheduler {
+public:
+    struct thread_stats {
+        double busy_ms;
+        double utilization; // busy time over the wall time of all runs
+        uint64_t tasks;
+        uint64_t steals;
+    };
+
+    // 0 threads uses every hardware thread
+    explicit task_scheduler(uint32_t requested_threads = 0)
+        : threads_(std::max(requested_threads ? requested_threads : std::thread::hardware_concurrency(), 1u)) {
+        for (uint32_t index = 1; index < thread_count(); ++index)
+            workers_.emplace_back([this, index] { worker(index); });
+    }
+
+    ~task_scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    task_scheduler(const task_scheduler&) = delete;
+    task_scheduler& operator=(const task_scheduler&) = delete;
+
+    uint32_t thread_count() const {
+        return static_cast<uint32_t>(threads_.size());
+    }
+
+    // runs `execute(task)` for every task of `graph`, each once all of its dependencies have finished, and returns when
+    // the last one is done
+    template <typename function>
+    void run(const task_graph& graph, function&& execute) {
+        const uint32_t task_count = graph.task_count();
+        if (task_count == 0) return;
+
+        auto start = std::chrono::steady_clock::now();
+
+        if (pending_capacity_ < task_count) {
+            pending_dependencies_ = std::make_unique<std::atomic<uint32_t>[]>(task_count);
+            pending_capacity_ = task_count;
+        }
+
+        // the tasks without dependencies are dealt round-robin so every thread starts on its own deque
+        uint32_t next_queue = 0;
+        for (uint32_t task = 0; task < task_count; ++task) {
+            pending_dependencies_[task].store(graph.dependency_count(task), std::memory_order_relaxed);
+
+            if (graph.dependency_count(task) == 0) {
+                threads_[next_queue].tasks.push_back(task);
+                next_queue = (next_queue + 1) % thread_count();
+            }
+        }
+
+        std::function<void(uint32_t)> job = execute;
+        remaining_tasks_.store(task_count, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            graph_ = &graph;
+            job_ = &job;
+            active_workers_ = static_cast<uint32_t>(workers_.size());
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        work(0);
+
+        // the graph and the job must outlive every worker's last look at them
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_workers_ == 0; });
+        graph_ = nullptr;
+        job_ = nullptr;
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        wall_ms_ += elapsed.count();
+    }
+
+    // `body(begin, end)` over [0, count) in a few independent chunks per thread
+    template <typename function>
+    void parallel_for(size_t count, function&& body) {
+        const size_t chunks = std::min<size_t>(count, 4 * thread_count());
+
+        chunk_graph_.clear();
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+            chunk_graph_.add_task();
+
+        run(chunk_graph_, [&](uint32_t chunk) {
+            body(count * chunk / chunks, count * (chunk + 1) / chunks);
+        });
+    }
+
+    std::vector<thread_stats> stats() const {
+        std::vector<thread_stats> result;
+
+        for (const auto& thread : threads_)
+            result.push_back({ thread.busy_ms, wall_ms_ > 0.0 ? thread.busy_ms / wall_ms_ : 0.0, thread.tasks_run, thread.steals });
+
+        return result;
+    }
+
+    // mean over the threads of their busy fraction
+    double mean_utilization() const {
+        double sum = 0.0;
+        for (const auto& thread : stats())
+            sum += thread.utilization;
+
+        return sum / thread_count();
+    }
+
+    void print_utilization(std::ostream& out) const {
+        auto all = stats();
+
+        out << "    " << all.size() << " threads over " << wall_ms_ << " ms of task graphs, " << 100.0 * mean_utilization() << "% mean utilization" << std::endl;
+
+        for (size_t index = 0; index < all.size(); ++index) {
+            out << "    thread " << index << ": " << 100.0 * all[index].utilization << "% busy, " << all[index].tasks << " tasks, "
+                << all[index].steals << " stolen" << std::endl;
+        }
+    }
+
+    void reset_stats() {
+        for (auto& thread : threads_) {
+            thread.busy_ms = 0.0;
+            thread.tasks_run = 0;
+            thread.steals = 0;
+        }
+
+        wall_ms_ = 0.0;
+    }
+
+private:
+    // a cache line each, the statistics are written by the owning thread only
+    struct alignas(64) thread_state {
+        std::mutex mutex;
+        std::deque<uint32_t> tasks;
+
+        double busy_ms = 0.0;
+        uint64_t tasks_run = 0;
+        uint64_t steals = 0;
+    };
+
+    bool pop(uint32_t index, uint32_t& task) {
+        auto& own = threads_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (own.tasks.empty()) return false;
+
+        task = own.tasks.back();
+        own.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(uint32_t index, uint32_t& task) {
+        for (uint32_t offset = 1; offset < thread_count(); ++offset) {
+            auto& victim = threads_[(index + offset) % thread_count()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            if (victim.tasks.empty()) continue;
+
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            ++threads_[index].steals;
+            return true;
+        }
+
+        return false;
+    }
+
+    void execute(uint32_t index, uint32_t task) {
+        auto& own = threads_[index];
+        auto start = std::chrono::steady_clock::now();
+
+        (*job_)(task);
+
+        // successors released here run next on this thread unless someone steals them first
+        for (uint32_t successor : graph_->successors(task)) {
+            if (pending_dependencies_[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.tasks.push_back(successor);
+            }
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        own.busy_ms += elapsed.count();
+        ++own.tasks_run;
+
+        remaining_tasks_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void work(uint32_t index) {
+        uint32_t task;
+
+        while (remaining_tasks_.load(std::memory_order_acquire) > 0) {
+            if (pop(index, task) || steal(index, task))
+                execute(index, task);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void worker(uint32_t index) {
+        uint64_t seen_generation = 0;
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+
+                if (stopping_) return;
+
+                seen_generation = generation_;
+            }
+
+            work(index);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--active_workers_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    std::vector<thread_state> threads_;
+    std::vector<std::thread> workers_;
+
+    const task_graph* graph_ = nullptr;
+    const std::function<void(uint32_t)>* job_ = nullptr;
+    std::unique_ptr<std::atomic<uint32_t>[]> pending_dependencies_;
+    uint32_t pending_capacity_ = 0;
+    std::atomic<uint32_t> remaining_tasks_{ 0 };
+    task_graph chunk_graph_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint32_t active_workers_ = 0;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+
+    double wall_ms_ = 0.0;
+};
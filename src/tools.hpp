@@ -1,19 +1,26 @@
-#pragma once
-#include "config.hpp"
-
-namespace tools {
-	struct params {
-		static constexpr uint32_t WIDTH = 1800; // 1800
-		static constexpr uint32_t HEIGHT = 900; // 900
-	};
-	
-	template<typename T>
-	[[nodiscard]] T get_CreateInfo(auto& factory) {
-		auto pinfo = reinterpret_cast<T*>(&factory);
-		return *pinfo;
-	}
-
-	std::vector <const char*> requested_extensions = {
-			VK_KHR_SWAPCHAIN_EXTENSION_NAME
-	};
+#pragma once
+#include "config.hpp"
+
+namespace tools {
+	struct params {
+		static constexpr uint32_t WIDTH = 1800; // 1800
+		static constexpr uint32_t HEIGHT = 900; // 900
+	};
+	
+	template<typename T>
+	[[nodiscard]] T get_CreateInfo(auto& factory) {
+		auto pinfo = reinterpret_cast<T*>(&factory);
+		return *pinfo;
+	}
+
+	// upper bound of minStorageBufferOffsetAlignment allowed by the spec
+	constexpr size_t storage_buffer_alignment = 256;
+
+	constexpr size_t align_up(size_t value, size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	std::vector <const char*> requested_extensions = {
+			VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	};
 }
\ No newline at end of file
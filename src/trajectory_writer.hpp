@@ -0,0 +1,346 @@
+#pragma once
+#include "config.hpp"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A trajectory file is a trajectory_header followed by one trajectory_frame_header and its payload per frame. A raw
+// payload is the position, velocity, density and pressure arrays back to back, in the element formats of the packed
+// particle buffer: fp32, or fp16 velocity, density and pressure (pressure in units of the stiffness) with
+// trajectory_compact_fields. A compressed payload is the raw payload XORed with the raw payload of the frame before it,
+// unless it is a keyframe, split into the four byte planes of its 32-bit words and stored as alternating varints of a
+// zero run length and a literal run length followed by the literal bytes, see trajectory_writer::decompress. Every array
+// has a slot per particle the simulation has room for; the live particles of a frame are the first particle_count of
+// its frame header, whatever follows them is stale.
+enum trajectory_flags : uint32_t {
+    trajectory_compact_fields = 1, // header: fp16 velocity, density and pressure
+    trajectory_compressed = 2, // header: frames may be compressed; frame: this one is
+    trajectory_keyframe = 4 // frame: decodes without the frame before it
+};
+
+struct trajectory_header {
+    char magic[8]; // "SPHTRAJ\0"
+    uint32_t version;
+    uint32_t flags;
+    uint32_t particle_count; // slots of every array
+    uint32_t keyframe_interval;
+    uint32_t position_bytes;
+    uint32_t velocity_bytes;
+    uint32_t density_bytes;
+    uint32_t pressure_bytes;
+    float particle_radius;
+    float dt; // the fixed time step, or the first one with an adaptive time step
+};
+
+static_assert(sizeof(trajectory_header) == 48, "the trajectory header is written as is");
+
+struct trajectory_frame_header {
+    uint64_t step;
+    float simulated_time;
+    uint32_t flags;
+    uint32_t stored_bytes; // of the payload that follows
+    uint32_t particle_count; // live particles at the front of every array
+};
+
+static_assert(sizeof(trajectory_frame_header) == 24, "the frame header is written as is");
+
+// Streams frames from a ring of readback slots to a trajectory file on its own thread. The simulation takes a free slot,
+// submits a copy into it and pushes it without waiting; the writer waits for the copy, takes the frame out of the slot,
+// hands the slot back and only then compresses and writes. When the writer falls behind, the ring runs out of free slots
+// and frames are dropped instead of ever holding up the simulation.
+class trajectory_writer {
+public:
+    static constexpr uint32_t version = 2;
+    static constexpr uint32_t keyframe_interval = 64;
+
+    // `slots` are the mapped readback buffers, each holding a payload of `frame_bytes` followed by the simulated time as a
+    // float; `wait_for_slot` blocks until the copy last submitted into a slot has landed
+    trajectory_writer(const std::string& path, const trajectory_header& header, std::vector<const char*> slots, size_t frame_bytes,
+        std::function<void(uint32_t)> wait_for_slot)
+        : path_(path), header_(header), slots_(std::move(slots)), frame_bytes_(frame_bytes), wait_for_slot_(std::move(wait_for_slot)),
+          file_(path, std::ios::binary | std::ios::trunc) {
+        if (!file_)
+            throw std::runtime_error("cannot write " + path);
+
+        file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+
+        for (uint32_t slot = 0; slot < slots_.size(); ++slot)
+            free_slots_.push_back(slot);
+
+        frame_.resize(frame_bytes_);
+        previous_frame_.resize(frame_bytes_);
+
+        writer_ = std::thread([this] { write_loop(); });
+    }
+
+    // every frame pushed so far is still written
+    ~trajectory_writer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        pushed_.notify_one();
+        writer_.join();
+    }
+
+    trajectory_writer(const trajectory_writer&) = delete;
+    trajectory_writer& operator=(const trajectory_writer&) = delete;
+
+    // a free slot, or nothing when the writer still holds every slot and the frame is dropped
+    std::optional<uint32_t> acquire_slot() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++captures_;
+
+        // half the ring or more still waiting to be written means the disk is not keeping up with the capture rate
+        if (2 * free_slots_.size() <= slots_.size())
+            ++backpressured_captures_;
+
+        if (free_slots_.empty()) {
+            ++dropped_frames_;
+            return std::nullopt;
+        }
+
+        uint32_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        return slot;
+    }
+
+    // queues a slot whose copy has been submitted; without a simulated time it is read from behind the payload
+    void push(uint32_t slot, uint64_t step, std::optional<float> simulated_time) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back({ slot, step, simulated_time });
+            peak_queued_ = std::max(peak_queued_, queue_.size());
+        }
+        pushed_.notify_one();
+    }
+
+    // blocks until every pushed frame is on disk
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return queue_.empty() && !writing_; });
+        file_.flush();
+    }
+
+    void print_stats(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        out << "    trajectory: " << frames_written_ << " frames written to " << path_ << ", " << stored_bytes_ / 1048576.0 << " MB";
+        if (header_.flags & trajectory_compressed)
+            out << " (" << raw_bytes_ / 1048576.0 << " MB raw, " << (stored_bytes_ ? static_cast<double>(raw_bytes_) / stored_bytes_ : 0.0) << "x)";
+        out << ", " << dropped_frames_ << " dropped and " << backpressured_captures_ << " backpressured of " << captures_
+            << " captures, at most " << peak_queued_ << " of " << slots_.size() << " slots queued" << std::endl;
+    }
+
+    // restores the raw payload of a stored frame; `previous` is the raw payload of the frame before it, unused for keyframes
+    static void decompress(const uint8_t* data, size_t size, const std::vector<char>& previous, bool keyframe, std::vector<char>& frame) {
+        std::vector<uint8_t> planes(frame.size(), 0);
+        size_t in = 0;
+        size_t out = 0;
+
+        while (in < size && out < planes.size()) {
+            out += read_varint(data, in);
+
+            size_t literal = read_varint(data, in);
+            std::memcpy(planes.data() + out, data + in, literal);
+            in += literal;
+            out += literal;
+        }
+
+        unshuffle(planes, frame);
+
+        if (!keyframe)
+            for (size_t i = 0; i < frame.size(); ++i)
+                frame[i] ^= previous[i];
+    }
+
+private:
+    struct pending_frame {
+        uint32_t slot;
+        uint64_t step;
+        std::optional<float> simulated_time;
+    };
+
+    void write_loop() {
+        for (;;) {
+            pending_frame pending;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                pushed_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+
+                if (queue_.empty()) return;
+
+                pending = queue_.front();
+                queue_.pop_front();
+                writing_ = true;
+            }
+
+            wait_for_slot_(pending.slot);
+
+            const char* slot = slots_[pending.slot];
+            std::memcpy(frame_.data(), slot, frame_bytes_);
+
+            float simulated_time;
+            if (pending.simulated_time)
+                simulated_time = *pending.simulated_time;
+            else
+                std::memcpy(&simulated_time, slot + frame_bytes_, sizeof(float));
+
+            uint32_t particle_count;
+            std::memcpy(&particle_count, slot + frame_bytes_ + sizeof(float), sizeof(uint32_t));
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                free_slots_.push_back(pending.slot);
+            }
+
+            write_frame(pending.step, simulated_time, particle_count);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                writing_ = false;
+            }
+            idle_.notify_all();
+        }
+    }
+
+    void write_frame(uint64_t step, float simulated_time, uint32_t particle_count) {
+        trajectory_frame_header frame_header{};
+        frame_header.step = step;
+        frame_header.simulated_time = simulated_time;
+        frame_header.particle_count = particle_count;
+
+        const char* payload = frame_.data();
+        size_t payload_bytes = frame_bytes_;
+
+        if (header_.flags & trajectory_compressed) {
+            const bool keyframe = frames_written_ % keyframe_interval == 0;
+            compress(keyframe);
+
+            // frames that do not shrink, like the first moves out of a lattice, are stored raw
+            if (compressed_.size() < frame_bytes_) {
+                payload = reinterpret_cast<const char*>(compressed_.data());
+                payload_bytes = compressed_.size();
+                frame_header.flags = keyframe ? trajectory_compressed | trajectory_keyframe : trajectory_compressed;
+            }
+        }
+
+        if (!(frame_header.flags & trajectory_compressed))
+            frame_header.flags = trajectory_keyframe;
+
+        frame_header.stored_bytes = static_cast<uint32_t>(payload_bytes);
+
+        file_.write(reinterpret_cast<const char*>(&frame_header), sizeof(frame_header));
+        file_.write(payload, payload_bytes);
+
+        // the next frame is XORed with this one, whichever way this one was stored
+        std::swap(frame_, previous_frame_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++frames_written_;
+        raw_bytes_ += frame_bytes_;
+        stored_bytes_ += payload_bytes;
+    }
+
+    // XOR with the previous frame, byte planes, zero runs; neighbouring particles move alike between two frames, so the
+    // sign, exponent and top mantissa bytes mostly cancel and line up in long runs of zeros
+    void compress(bool keyframe) {
+        planes_.resize(frame_bytes_);
+
+        const size_t words = frame_bytes_ / 4;
+        for (size_t word = 0; word < words; ++word)
+            for (size_t byte = 0; byte < 4; ++byte) {
+                size_t i = 4 * word + byte;
+                planes_[byte * words + word] = static_cast<uint8_t>(keyframe ? frame_[i] : frame_[i] ^ previous_frame_[i]);
+            }
+
+        for (size_t i = 4 * words; i < frame_bytes_; ++i)
+            planes_[i] = static_cast<uint8_t>(keyframe ? frame_[i] : frame_[i] ^ previous_frame_[i]);
+
+        compressed_.clear();
+
+        size_t i = 0;
+        while (i < planes_.size()) {
+            size_t zeros = 0;
+            while (i + zeros < planes_.size() && planes_[i + zeros] == 0)
+                ++zeros;
+
+            // a literal run ends at the next pair of zeros, a single zero costs less inside it than as its own run
+            size_t literal_begin = i + zeros;
+            size_t literal_end = literal_begin;
+            while (literal_end < planes_.size() && !(planes_[literal_end] == 0 && (literal_end + 1 == planes_.size() || planes_[literal_end + 1] == 0)))
+                ++literal_end;
+
+            write_varint(zeros);
+            write_varint(literal_end - literal_begin);
+            compressed_.insert(compressed_.end(), planes_.begin() + literal_begin, planes_.begin() + literal_end);
+
+            i = literal_end;
+        }
+    }
+
+    void write_varint(size_t value) {
+        while (value >= 0x80) {
+            compressed_.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        compressed_.push_back(static_cast<uint8_t>(value));
+    }
+
+    static size_t read_varint(const uint8_t* data, size_t& in) {
+        size_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = data[in++];
+            value |= static_cast<size_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+    }
+
+    static void unshuffle(const std::vector<uint8_t>& planes, std::vector<char>& frame) {
+        const size_t words = frame.size() / 4;
+        for (size_t word = 0; word < words; ++word)
+            for (size_t byte = 0; byte < 4; ++byte)
+                frame[4 * word + byte] = static_cast<char>(planes[byte * words + word]);
+
+        for (size_t i = 4 * words; i < frame.size(); ++i)
+            frame[i] = static_cast<char>(planes[i]);
+    }
+
+    std::string path_;
+    trajectory_header header_;
+    std::vector<const char*> slots_;
+    size_t frame_bytes_;
+    std::function<void(uint32_t)> wait_for_slot_;
+    std::ofstream file_;
+
+    // owned by the writer thread
+    std::vector<char> frame_;
+    std::vector<char> previous_frame_;
+    std::vector<uint8_t> planes_;
+    std::vector<uint8_t> compressed_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable pushed_;
+    std::condition_variable idle_;
+    std::deque<pending_frame> queue_;
+    std::vector<uint32_t> free_slots_;
+    bool writing_ = false;
+    bool stopping_ = false;
+
+    uint64_t captures_ = 0;
+    uint64_t dropped_frames_ = 0;
+    uint64_t backpressured_captures_ = 0;
+    size_t peak_queued_ = 0;
+    uint64_t frames_written_ = 0;
+    uint64_t raw_bytes_ = 0;
+    uint64_t stored_bytes_ = 0;
+
+    std::thread writer_;
+};